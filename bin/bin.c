@@ -2,6 +2,7 @@
 #include "../kernel/kernel.h"
 #include "echo.h"
 #include "help.h"
+#include "meminfo.h"
 #include "../network/network.h"
 #include "../include/string.h"
 #include "../include/types.h"
@@ -14,6 +15,8 @@ void bin_execute(const char *cmd, const char *arg) {
         bin_help();
     } else if (strcmp(cmd, "netstat") == 0) {
         netstat();
+    } else if (strcmp(cmd, "meminfo") == 0) {
+        bin_meminfo(arg);
     } else {
         kprint("Unknown command.\n");
     }
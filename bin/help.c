@@ -2,5 +2,5 @@
 #include "../kernel/kernel.h"
 
 void bin_help() {
-    kprint("Commands: echo, help, netstat\n");
+    kprint("Commands: echo, help, meminfo, netstat\n");
 }
@@ -0,0 +1,55 @@
+#include "meminfo.h"
+#include "../kernel/kernel.h"
+#include "../include/kernel/mm.h"
+#include "../include/string.h"
+#include "../include/types.h"
+
+// meminfo      heap, allocator and frame statistics
+// meminfo map  the physical memory map
+void bin_meminfo(const char *arg) {
+    memory_stats_t st;
+
+    if (arg && strcmp(arg, "map") == 0) {
+        mm_print_map();
+        return;
+    }
+
+    mm_get_stats(&st);
+
+    kprintf("Heap:   %zu bytes in use, peak %zu, %zu KB mapped\n",
+            st.bytes_in_use, st.peak_in_use, st.total_memory / 1024);
+    kprintf("Blocks: %zu, %zu bytes free, largest %zu",
+            st.block_count, st.free_memory, st.largest_free);
+    if (st.free_memory != 0) {
+        kprintf(" (%zu%% fragmented)", 100 - st.largest_free * 100 / st.free_memory);
+    }
+    kprintf("\n");
+    kprintf("Calls:  kmalloc %zu, kfree %zu, krealloc %zu in place/%zu moved\n",
+            st.alloc_count, st.free_count, st.realloc_inplace, st.realloc_moved);
+    kprintf("IRQ:    %zu allocs, %zu failed\n", st.irq_alloc_count, st.irq_alloc_failed);
+
+    // Build each list line in one buffer so it reaches the console in one write
+    char line[160];
+    size_t len = ksnprintf(line, sizeof(line), "Sizes: ");
+    for (int i = 0; i < MM_HIST_BUCKETS && len < sizeof(line); i++) {
+        if (st.size_hist[i] == 0) {
+            continue;
+        }
+        len += ksnprintf(line + len, sizeof(line) - len, " %s%zu:%zu",
+                         i == MM_HIST_BUCKETS - 1 ? ">" : "<=",
+                         (size_t)16 << (i == MM_HIST_BUCKETS - 1 ? i - 1 : i),
+                         st.size_hist[i]);
+    }
+    kprintf("%s\n", line);
+
+    len = ksnprintf(line, sizeof(line), "Slabs: ");
+    for (int i = 0; i < MM_SIZE_CLASSES && len < sizeof(line); i++) {
+        len += ksnprintf(line + len, sizeof(line) - len, " %zu:%zu",
+                         st.class_size[i], st.class_slabs[i]);
+    }
+    kprintf("%s\n", line);
+
+    kprintf("Frames: %zu KB free of %zu KB, zero pool %zu (%zu hits, %zu misses)\n",
+            st.phys_free / 1024, st.phys_total / 1024, st.zero_pool,
+            st.zero_hits, st.zero_misses);
+}
@@ -0,0 +1,6 @@
+#ifndef MEMINFO_H
+#define MEMINFO_H
+
+void bin_meminfo(const char *arg);
+
+#endif
@@ -1,6 +1,7 @@
 #include "keyboard.h"
 #include "../libc/string.h"
 #include "vga.h"   // optional for debug prints
+#include "../include/kernel.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -27,6 +28,20 @@ static const char scancode_to_ascii[] = {
 
 // inb and outb are defined in kernel/io.h
 
+#define SC_EXTENDED     0xE0    // Prefix of the next scancode
+#define SC_LSHIFT       0x2A
+#define SC_RSHIFT       0x36
+#define SC_ALT          0x38    // Left Alt, or right Alt after SC_EXTENDED
+#define SC_F1           0x3B    // F1..F6 are consecutive
+#define SC_F6           0x40
+#define SC_RELEASE      0x80    // Set in key release scancodes
+#define SC_EXT_PGUP     0x49    // After SC_EXTENDED
+#define SC_EXT_PGDN     0x51
+
+static bool shift_down;
+static bool alt_down;
+static bool extended;
+
 // Put char into circular buffer
 static void buffer_put(char c) {
     int next = (head + 1) % KBD_BUFFER_SIZE;
@@ -52,9 +67,44 @@ void keyboard_handler(registers_t *regs)
     uint8_t status = inb(KBD_STATUS_PORT);
     if (status & 0x01) {
         uint8_t scancode = inb(KBD_DATA_PORT);
-        
-        // Only handle key press events (ignore key releases for now)
-        if (scancode < 0x80) {
+
+        if (scancode == SC_EXTENDED) {
+            extended = true;
+            return;
+        }
+        bool was_extended = extended;
+        extended = false;
+
+        uint8_t key = scancode & ~SC_RELEASE;
+        if (!was_extended && (key == SC_LSHIFT || key == SC_RSHIFT)) {
+            shift_down = !(scancode & SC_RELEASE);
+            return;
+        }
+        if (key == SC_ALT) {
+            alt_down = !(scancode & SC_RELEASE);
+            return;
+        }
+
+        // Alt+F1..F6 switch virtual consoles
+        if (!was_extended && alt_down && scancode >= SC_F1 && scancode <= SC_F6) {
+            vga_console_switch(scancode - SC_F1);
+            return;
+        }
+
+        // Shift+PgUp/PgDn page through the console scrollback
+        if (was_extended && shift_down && scancode == SC_EXT_PGUP) {
+            vga_scroll_view(1);
+            return;
+        }
+        if (was_extended && shift_down && scancode == SC_EXT_PGDN) {
+            vga_scroll_view(-1);
+            return;
+        }
+
+        // Only handle key press events (ignore key releases for now).
+        // The shell reads console 0, so typing elsewhere is dropped rather
+        // than echoed somewhere invisible.
+        if (!was_extended && scancode < sizeof(scancode_to_ascii) && vga_console_shown() == 0) {
             char c = scancode_to_ascii[scancode];
             if (c) {
                 buffer_put(c);
@@ -76,8 +126,8 @@ void keyboard_init(void) {
 char keyboard_get_char(void) {
     char c = 0;
     while (!(c = buffer_get())) {
-        // optionally halt lol CPU to save power until interrupt fires
-        __asm__ volatile("hlt");
+        // Zero pages in the background, halting once there's nothing to do
+        idle();
     }
     return c;
 }
@@ -0,0 +1,94 @@
+#include "scrollback.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// A line is stored as
+//
+//   fill attr, run count, then per run: attr, length, characters
+//
+// and the cells after the last run are blanks in the fill attribute.
+// The longest encoding (every cell its own run) is 2 + 3 * WIDTH bytes.
+
+#define MAX_LINE_BYTES (2 + 3 * SCROLLBACK_WIDTH)
+
+void scrollback_init(struct scrollback* sb, uint8_t* data, uint32_t data_size,
+                     uint32_t* start, uint32_t max_lines) {
+    sb->data = data;
+    sb->data_size = data_size;
+    sb->start = start;
+    sb->max_lines = max_lines;
+    sb->first = 0;
+    sb->count = 0;
+    sb->head = 0;
+}
+
+static inline uint8_t byte_at(const struct scrollback* sb, uint32_t pos) {
+    return sb->data[pos & (sb->data_size - 1)];
+}
+
+static inline void put_byte(struct scrollback* sb, uint8_t value) {
+    sb->data[sb->head & (sb->data_size - 1)] = value;
+    sb->head++;
+}
+
+void scrollback_push(struct scrollback* sb, const uint16_t* row) {
+    // Drop trailing blanks that match the last cell
+    size_t len = SCROLLBACK_WIDTH;
+    uint16_t last = row[SCROLLBACK_WIDTH - 1];
+    uint8_t fill = last >> 8;
+    if ((last & 0xFF) == ' ') {
+        while (len > 0 && row[len - 1] == last) {
+            len--;
+        }
+    }
+
+    // Make room: a whole line's worth of bytes and an index slot
+    while (sb->count > 0 && (sb->count == sb->max_lines ||
+           sb->head + MAX_LINE_BYTES - sb->start[sb->first & (sb->max_lines - 1)] > sb->data_size)) {
+        sb->first++;
+        sb->count--;
+    }
+
+    sb->start[(sb->first + sb->count) & (sb->max_lines - 1)] = sb->head;
+    sb->count++;
+
+    put_byte(sb, fill);
+    uint32_t runs_at = sb->head;
+    put_byte(sb, 0);
+
+    uint8_t runs = 0;
+    for (size_t x = 0; x < len; ) {
+        uint8_t attr = row[x] >> 8;
+        size_t end = x + 1;
+        while (end < len && (row[end] >> 8) == attr) {
+            end++;
+        }
+        put_byte(sb, attr);
+        put_byte(sb, (uint8_t)(end - x));
+        for (; x < end; x++) {
+            put_byte(sb, (uint8_t)row[x]);
+        }
+        runs++;
+    }
+    sb->data[runs_at & (sb->data_size - 1)] = runs;
+}
+
+void scrollback_get(const struct scrollback* sb, uint32_t n, uint16_t* row) {
+    uint32_t pos = sb->start[(sb->first + sb->count - n) & (sb->max_lines - 1)];
+    uint16_t fill = (uint16_t)byte_at(sb, pos) << 8;
+    uint8_t runs = byte_at(sb, pos + 1);
+    pos += 2;
+
+    size_t x = 0;
+    while (runs-- > 0) {
+        uint16_t attr = (uint16_t)byte_at(sb, pos) << 8;
+        uint8_t length = byte_at(sb, pos + 1);
+        pos += 2;
+        while (length-- > 0) {
+            row[x++] = attr | byte_at(sb, pos++);
+        }
+    }
+    while (x < SCROLLBACK_WIDTH) {
+        row[x++] = fill | ' ';
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Lines that scrolled off a text console, kept compactly: each row is
+// stored as runs of characters sharing one attribute, with trailing
+// blanks dropped. The oldest lines are discarded when either the line
+// index or the byte store fills up.
+
+#define SCROLLBACK_WIDTH 80
+
+struct scrollback {
+    uint8_t* data;          // Encoded rows, a byte ring
+    uint32_t data_size;     // Power of two
+    uint32_t* start;        // Ring of byte offsets, one per line
+    uint32_t max_lines;     // Power of two
+    uint32_t first;         // Index of the oldest line (runs freely)
+    uint32_t count;         // Lines kept
+    uint32_t head;          // Next free byte (runs freely)
+};
+
+// Set up sb over caller-provided storage (both sizes powers of two)
+void scrollback_init(struct scrollback* sb, uint8_t* data, uint32_t data_size,
+                     uint32_t* start, uint32_t max_lines);
+
+// Append one row of SCROLLBACK_WIDTH cells
+void scrollback_push(struct scrollback* sb, const uint16_t* row);
+
+// Decode line n back from the newest (1 = most recent) into
+// SCROLLBACK_WIDTH cells; n must be between 1 and sb->count
+void scrollback_get(const struct scrollback* sb, uint32_t n, uint16_t* row);
+
+#endif
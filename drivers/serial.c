@@ -1,6 +1,9 @@
 #include "serial.h"
+#include <stddef.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include "../include/kernel/io.h"
+#include "../include/kernel/util.h"
 
 void serial_init(uint16_t port, uint32_t baud_rate) {
     uint16_t divisor = 115200 / baud_rate;
@@ -32,15 +35,38 @@ void serial_write_byte(uint16_t port, char c) {
     outb(port, c);
 }
 
-void serial_write_string(uint16_t port, const char* str) {
-    while (*str) {
-        if (*str == '\n') {
-            serial_write_byte(port, '\r');
+// The transmit FIFO holds 16 bytes (enabled in serial_init), so one
+// "transmitter empty" poll covers that many writes
+#define SERIAL_FIFO_SIZE 16
+
+void serial_write_buffer(uint16_t port, const char* buf, size_t len) {
+    size_t i = 0;
+    bool cr_sent = false;   // '\r' already written for the '\n' at buf[i]
+
+    while (i < len) {
+        while ((inb(port + 5) & 0x20) == 0) {
+            __asm__ volatile("pause");
+        }
+        for (int room = SERIAL_FIFO_SIZE; room > 0 && i < len; room--) {
+            if (buf[i] == '\n' && !cr_sent) {
+                outb(port, '\r');
+                cr_sent = true;
+                continue;
+            }
+            outb(port, buf[i++]);
+            cr_sent = false;
         }
-        serial_write_byte(port, *str++);
     }
 }
 
+void serial_write_string(uint16_t port, const char* str) {
+    size_t len = 0;
+    while (str[len]) {
+        len++;
+    }
+    serial_write_buffer(port, str, len);
+}
+
 uint8_t serial_received(uint16_t port) {
     return inb(port + 5) & 1;
 }
@@ -53,24 +79,12 @@ char serial_read_char(uint16_t port) {
 }
 
 void serial_write_hex(uint16_t port, uint32_t n) {
-    const char* hex_chars = "0123456789ABCDEF";
     char buffer[9]; // 8 hex digits + null terminator
-    
-    // Convert each nibble to a hex character
-    for (int i = 7; i >= 0; i--) {
-        buffer[7 - i] = hex_chars[(n >> (i * 4)) & 0xF];
-    }
-    buffer[8] = '\0';
-    
-    // Skip leading zeros
-    int start = 0;
-    while (start < 7 && buffer[start] == '0') {
-        start++;
-    }
-    
-    // Write the hex string
+
+    // No leading zeros
+    kfmt_hex(buffer, n, 0);
     serial_write_string(port, "0x");
-    serial_write_string(port, buffer + start);
+    serial_write_string(port, buffer);
 }
 
 void serial_read_line(uint16_t port, char* buffer, uint32_t max_length) {
@@ -2,6 +2,7 @@
 #define SERIAL_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include "../include/kernel/io.h"
 
 // COM1 base port
@@ -16,6 +17,9 @@ void serial_write_byte(uint16_t port, char c);
 // Write a null-terminated string to serial port
 void serial_write_string(uint16_t port, const char* str);
 
+// Write len bytes, polling the port once per FIFO load instead of per byte
+void serial_write_buffer(uint16_t port, const char* buf, size_t len);
+
 // Check if data is available to read
 uint8_t serial_received(uint16_t port);
 
@@ -1,19 +1,107 @@
 #include "vga.h"
+#include "scrollback.h"
+#include "../include/kernel/util.h"
 #include <stddef.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
 #define VGA_MEMORY ((uint16_t*)0xB8000)
+#define VGA_WINDOW_CELLS 16384  // Cells in the 32 KiB text window
 
 #define VGA_CMD_PORT  0x3D4
 #define VGA_DATA_PORT 0x3D5
 
+#define DEFAULT_COLOR (VGA_COLOR_LIGHT_GREY | (VGA_COLOR_BLACK << 4))
+
 static uint16_t* const video_mem = VGA_MEMORY;
 
-static uint8_t cursor_row = 0;
-static uint8_t cursor_col = 0;
-static uint8_t vga_color = (VGA_COLOR_LIGHT_GREY | (VGA_COLOR_BLACK << 4));
+// Each virtual console draws into its own copy of the screen, and only
+// the visible one is copied to video memory: rows that changed are
+// written by vga_flush(). Text-mode MMIO is uncached, so a row written
+// once beats a cell written many times (and the CRTC cursor registers
+// are set once per flush instead of once per character). Output to a
+// background console never touches the hardware at all.
+//
+// Scrolling moves nothing. A console's cells are a ring of rows starting
+// at `top`, and the screen is a 25-row view into the 32 KiB text window
+// starting at cell `origin` (CRTC start address): a scroll moves both
+// down a row, and only the new bottom row has to be drawn. When the view
+// reaches the end of the window it goes back to the start and the whole
+// screen is drawn there once.
+//
+// Rows scrolled off the top go to the console's scrollback. While the
+// visible console is scrolled back into it (view_back rows), video memory
+// shows the `view` copy instead of the console; output keeps going to
+// the console, and the view stays on the same lines until moved back down.
+// The kernel console keeps a long history; the others, which mostly hold
+// a shell or the log, get an eighth of it to keep the BSS small.
+#define SCROLLBACK_BYTES        (64 * 1024)
+#define SCROLLBACK_LINES        2048
+#define SCROLLBACK_BYTES_SMALL  (8 * 1024)
+#define SCROLLBACK_LINES_SMALL  256
+
+// Escape sequence parser states
+enum { ESC_NONE, ESC_START, ESC_CSI };
+#define ESC_MAX_PARAMS 4
+
+struct vconsole {
+    uint16_t* cells;            // VGA_HEIGHT rows, starting at row `top`
+    size_t top;
+    uint32_t dirty_rows;        // Bit y set: screen row y is out of date
+    uint8_t cursor_row;
+    uint8_t cursor_col;
+    uint8_t color;
+    struct scrollback history;
+    uint32_t view_back;         // Rows scrolled back; 0 = live output
+    bool view_stale;            // view needs recomputing
+    uint8_t esc_state;          // Escape sequence parser (ESC_*)
+    uint8_t esc_count;          // Index of the parameter being read
+    uint16_t esc_params[ESC_MAX_PARAMS];
+    uint8_t saved_row;          // ESC 7 / CSI s
+    uint8_t saved_col;
+    bool used;                  // Written to at least once; may be shown
+};
+
+static uint16_t console_cells[VGA_CONSOLES][VGA_WIDTH * VGA_HEIGHT];
+static uint8_t kcon_history_data[SCROLLBACK_BYTES];
+static uint32_t kcon_history_index[SCROLLBACK_LINES];
+static uint8_t history_data[VGA_CONSOLES - 1][SCROLLBACK_BYTES_SMALL];
+static uint32_t history_index[VGA_CONSOLES - 1][SCROLLBACK_LINES_SMALL];
+
+#define CONSOLE(n, data, index) {                                       \
+    .cells = console_cells[n],                                          \
+    .color = DEFAULT_COLOR,                                             \
+    .history = { data, sizeof(data), index,                             \
+                 sizeof(index) / sizeof(index[0]), 0, 0, 0 },           \
+}
+
+static struct vconsole consoles[VGA_CONSOLES] = {
+    CONSOLE(0, kcon_history_data, kcon_history_index),
+    CONSOLE(1, history_data[0], history_index[0]),
+    CONSOLE(2, history_data[1], history_index[1]),
+    CONSOLE(3, history_data[2], history_index[2]),
+    CONSOLE(4, history_data[3], history_index[3]),
+    CONSOLE(5, history_data[4], history_index[4]),
+};
+
+// The kernel console (the vga_* calls without a console number) and the
+// one on screen
+static struct vconsole* const kcon = &consoles[0];
+static struct vconsole* shown = &consoles[0];
+
+static uint16_t view[VGA_WIDTH * VGA_HEIGHT];   // What the screen shows
+static uint16_t origin;         // Window cell shown top left
+static uint16_t hw_origin = 0xFFFF;
+static uint16_t hw_cursor = 0xFFFF;
+
+// Requests from the keyboard handler, carried out at the next flush
+static volatile int view_request;   // Half screens to move
+static volatile int switch_request = -1;
+
+#define ALL_ROWS ((1u << VGA_HEIGHT) - 1)
 
 // Port IO functions
 static inline void outb(uint16_t port, uint8_t val) {
@@ -31,69 +119,252 @@ static inline uint16_t vga_entry(char c, uint8_t color) {
     return (uint16_t)c | ((uint16_t)color << 8);
 }
 
-// Update hardware cursor to current pos
+// Screen row y of a console
+static inline uint16_t* console_row(const struct vconsole* vc, size_t y) {
+    y += vc->top;
+    if (y >= VGA_HEIGHT) {
+        y -= VGA_HEIGHT;
+    }
+    return &vc->cells[y * VGA_WIDTH];
+}
+
+// Update hardware cursor to current pos (if it moved); it is parked
+// below the screen while scrolled back too far to show it
 static void update_cursor() {
-    uint16_t pos = cursor_row * VGA_WIDTH + cursor_col;
+    uint32_t row = shown->cursor_row + shown->view_back;
+    uint16_t pos = origin + VGA_WIDTH * VGA_HEIGHT;
+    if (row < VGA_HEIGHT) {
+        pos = origin + row * VGA_WIDTH + shown->cursor_col;
+    }
+    if (pos == hw_cursor) {
+        return;
+    }
+    hw_cursor = pos;
     outb(VGA_CMD_PORT, 0x0F);
     outb(VGA_DATA_PORT, (uint8_t)(pos & 0xFF));
     outb(VGA_CMD_PORT, 0x0E);
     outb(VGA_DATA_PORT, (uint8_t)((pos >> 8) & 0xFF));
 }
 
-// Scroll screen up by one line
-void vga_scroll() {
-    // Move lines up ... Cool
-    for (size_t y = 1; y < VGA_HEIGHT; y++) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            video_mem[(y - 1) * VGA_WIDTH + x] = video_mem[y * VGA_WIDTH + x];
+// Point the CRTC start address at origin (if it moved)
+static void update_origin() {
+    if (origin == hw_origin) {
+        return;
+    }
+    hw_origin = origin;
+    outb(VGA_CMD_PORT, 0x0C);
+    outb(VGA_DATA_PORT, (uint8_t)(origin >> 8));
+    outb(VGA_CMD_PORT, 0x0D);
+    outb(VGA_DATA_PORT, (uint8_t)(origin & 0xFF));
+}
+
+// Bring the scrolled-back screen up to date, writing only rows that
+// differ from what is shown
+static void draw_view() {
+    uint16_t line[VGA_WIDTH];
+
+    for (size_t y = 0; y < VGA_HEIGHT; y++) {
+        const uint16_t* src;
+        if (y < shown->view_back) {
+            scrollback_get(&shown->history, shown->view_back - y, line);
+            src = line;
+        } else {
+            src = console_row(shown, y - shown->view_back);
+        }
+        uint16_t* on_screen = &view[y * VGA_WIDTH];
+        if (memcmp(on_screen, src, sizeof(line)) != 0) {
+            memcpy(on_screen, src, sizeof(line));
+            memcpy(&video_mem[origin + y * VGA_WIDTH], src, sizeof(line));
         }
     }
-    // Clear last line
-    uint16_t blank = vga_entry(' ', vga_color);
+    shown->view_stale = false;
+}
+
+static void flush_rows() {
+    for (uint32_t rows = shown->dirty_rows; rows != 0; rows &= rows - 1) {
+        size_t y = __builtin_ctz(rows);
+        memcpy(&video_mem[origin + y * VGA_WIDTH], console_row(shown, y),
+               VGA_WIDTH * sizeof(uint16_t));
+    }
+    shown->dirty_rows = 0;
+}
+
+// Show the screen from `back` rows up in the scrollback
+static void set_view(uint32_t back) {
+    if (back > shown->history.count) {
+        back = shown->history.count;
+    }
+    if (back == shown->view_back) {
+        return;
+    }
+
+    if (shown->view_back == 0) {
+        // Leaving live output: the screen matches the console once flushed
+        flush_rows();
+        for (size_t y = 0; y < VGA_HEIGHT; y++) {
+            memcpy(&view[y * VGA_WIDTH], console_row(shown, y), VGA_WIDTH * sizeof(uint16_t));
+        }
+    }
+    shown->view_back = back;
+    if (back != 0) {
+        shown->view_stale = true;
+        return;
+    }
+
+    // Back to live output: redraw the rows that differ from the view
+    shown->dirty_rows = 0;
+    for (size_t y = 0; y < VGA_HEIGHT; y++) {
+        if (memcmp(&view[y * VGA_WIDTH], console_row(shown, y), VGA_WIDTH * sizeof(uint16_t)) != 0) {
+            shown->dirty_rows |= 1u << y;
+        }
+    }
+}
+
+// Put another console on screen (live, not scrolled back)
+static void show_console(struct vconsole* vc) {
+    if (vc == shown) {
+        return;
+    }
+    set_view(0);
+    shown = vc;
+    vc->view_back = 0;
+    vc->dirty_rows = ALL_ROWS;
+}
+
+// Carry out console switches and view moves asked for by the keyboard
+static void apply_requests() {
+    int target = __sync_lock_test_and_set(&switch_request, -1);
+    if (target >= 0) {
+        show_console(&consoles[target]);
+    }
+
+    int steps = __sync_lock_test_and_set(&view_request, 0);
+    if (steps != 0) {
+        int32_t back = (int32_t)shown->view_back + steps * (VGA_HEIGHT / 2);
+        set_view(back > 0 ? (uint32_t)back : 0);
+    }
+}
+
+// Copy the changed rows to video memory and place the cursor
+void vga_flush() {
+    apply_requests();
+    if (shown->view_back == 0) {
+        flush_rows();
+    } else if (shown->view_stale || shown->view_back < VGA_HEIGHT) {
+        // Only the live rows at the bottom, if any, can have changed
+        draw_view();
+    }
+    update_origin();
+    update_cursor();
+}
+
+// Only queue the move: this runs in the keyboard handler, which must not
+// draw while mainline code may be halfway through an update
+void vga_scroll_view(int steps) {
+    __sync_add_and_fetch(&view_request, steps);
+}
+
+// Consoles nothing has written to stay hidden rather than show a blank
+// screen; the kernel console can always be shown
+void vga_console_switch(unsigned n) {
+    if (n < VGA_CONSOLES && (&consoles[n] == kcon || consoles[n].used)) {
+        switch_request = (int)n;
+    }
+}
+
+unsigned vga_console_shown() {
+    return (unsigned)(shown - consoles);
+}
+
+bool vga_poll() {
+    if (view_request == 0 && switch_request < 0) {
+        return false;
+    }
+    vga_flush();
+    return true;
+}
+
+static void fill_row(struct vconsole* vc, size_t y, uint16_t entry) {
+    uint16_t* row = console_row(vc, y);
     for (size_t x = 0; x < VGA_WIDTH; x++) {
-        video_mem[(VGA_HEIGHT - 1) * VGA_WIDTH + x] = blank;
+        row[x] = entry;
     }
+}
+
+// Scroll a console up by one line
+static void scroll(struct vconsole* vc) {
+    scrollback_push(&vc->history, console_row(vc, 0));
 
-    if (cursor_row > 0)
-        cursor_row--;
+    // Move lines up ... Cool (by moving where they start)
+    vc->top = (vc->top + 1) % VGA_HEIGHT;
+    if (vc != shown) {
+        vc->dirty_rows = ALL_ROWS;  // Redrawn in full when switched to
+    } else if (vc->view_back != 0) {
+        // Keep showing the same lines (unless they were dropped); the
+        // screen is not following the console, so origin stays
+        if (vc->view_back < vc->history.count) {
+            vc->view_back++;
+        } else {
+            vc->view_back = vc->history.count;
+            vc->view_stale = true;
+        }
+    } else if (origin + VGA_WIDTH * (VGA_HEIGHT + 1) <= VGA_WINDOW_CELLS) {
+        vc->dirty_rows >>= 1;
+        origin += VGA_WIDTH;
+    } else {
+        origin = 0;
+        vc->dirty_rows = ALL_ROWS;
+    }
+
+    // Clear last line
+    fill_row(vc, VGA_HEIGHT - 1, vga_entry(' ', vc->color));
+    vc->dirty_rows |= 1u << (VGA_HEIGHT - 1);
+
+    if (vc->cursor_row > 0)
+        vc->cursor_row--;
+}
+
+void vga_scroll() {
+    scroll(kcon);
 }
 
 // Clear entire screen
 void vga_clear() {
-    uint16_t blank = vga_entry(' ', vga_color);
-    for (size_t i = 0; i < VGA_WIDTH * VGA_HEIGHT; i++) {
-        video_mem[i] = blank;
+    for (size_t y = 0; y < VGA_HEIGHT; y++) {
+        fill_row(kcon, y, vga_entry(' ', kcon->color));
     }
-    cursor_row = 0;
-    cursor_col = 0;
-    update_cursor();
+    kcon->view_back = 0;
+    kcon->dirty_rows = ALL_ROWS;
+    kcon->cursor_row = 0;
+    kcon->cursor_col = 0;
+    vga_flush();
 }
 
 // Set foreground and background color
 void vga_set_color(uint8_t fg, uint8_t bg) {
-    vga_color = (fg & 0x0F) | ((bg & 0x0F) << 4);
+    kcon->color = (fg & 0x0F) | ((bg & 0x0F) << 4);
 }
 
 // Get current foreground and background colors
 void vga_get_color(uint8_t* fg, uint8_t* bg) {
-    if (fg) *fg = vga_color & 0x0F;
-    if (bg) *bg = (vga_color >> 4) & 0x0F;
+    if (fg) *fg = kcon->color & 0x0F;
+    if (bg) *bg = (kcon->color >> 4) & 0x0F;
 }
 
 // Move cursor to given row and col
 void vga_move_cursor(uint8_t row, uint8_t col) {
     if (row >= VGA_HEIGHT) row = VGA_HEIGHT - 1;
     if (col >= VGA_WIDTH) col = VGA_WIDTH - 1;
-    cursor_row = row;
-    cursor_col = col;
-    update_cursor();
+    kcon->cursor_row = row;
+    kcon->cursor_col = col;
+    vga_flush();
 }
 
 // Get cursor position
 // fuck cursors
 void vga_get_cursor(uint8_t* row, uint8_t* col) {
-    if (row) *row = cursor_row;
-    if (col) *col = cursor_col;
+    if (row) *row = kcon->cursor_row;
+    if (col) *col = kcon->cursor_col;
 }
 
 // Disable hardware cursor
@@ -110,78 +381,274 @@ void vga_enable_cursor(uint8_t cursor_start, uint8_t cursor_end) {
     outb(VGA_DATA_PORT, (inb(VGA_DATA_PORT) & 0xE0) | cursor_end);
 }
 
-// Write single character to screen PLUS spechial chars!! uwu
-void vga_putc(char c) {
+// ANSI colour number to VGA colour
+static const uint8_t ansi_to_vga[8] = {
+    VGA_COLOR_BLACK, VGA_COLOR_RED, VGA_COLOR_GREEN, VGA_COLOR_BROWN,
+    VGA_COLOR_BLUE, VGA_COLOR_MAGENTA, VGA_COLOR_CYAN, VGA_COLOR_LIGHT_GREY,
+};
+
+// Blank cells [from, to) of screen row y
+static void erase(struct vconsole* vc, size_t y, size_t from, size_t to) {
+    uint16_t* row = console_row(vc, y);
+    uint16_t blank = vga_entry(' ', vc->color);
+    for (size_t x = from; x < to; x++) {
+        row[x] = blank;
+    }
+    vc->dirty_rows |= 1u << y;
+}
+
+// SGR: colours and brightness
+static void select_graphics(struct vconsole* vc, const uint16_t* params, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint16_t p = params[i];
+        uint8_t fg = vc->color & 0x0F;
+        uint8_t bg = vc->color >> 4;
+
+        if (p == 0) {
+            fg = DEFAULT_COLOR & 0x0F;
+            bg = DEFAULT_COLOR >> 4;
+        } else if (p == 1) {
+            fg |= 0x08;
+        } else if (p == 22) {
+            fg &= 0x07;
+        } else if (p >= 30 && p <= 37) {
+            fg = (fg & 0x08) | ansi_to_vga[p - 30];
+        } else if (p == 39) {
+            fg = (fg & 0x08) | (DEFAULT_COLOR & 0x07);
+        } else if (p >= 40 && p <= 47) {
+            bg = ansi_to_vga[p - 40];
+        } else if (p == 49) {
+            bg = DEFAULT_COLOR >> 4;
+        } else if (p >= 90 && p <= 97) {
+            fg = ansi_to_vga[p - 90] | 0x08;
+        } else if (p >= 100 && p <= 107) {
+            // Bright backgrounds would blink; use the normal ones
+            bg = ansi_to_vga[p - 100];
+        }
+        vc->color = fg | (bg << 4);
+    }
+}
+
+// Carry out CSI sequence `final` (parameters of 0 mean "default")
+static void control_sequence(struct vconsole* vc, char final) {
+    const uint16_t* p = vc->esc_params;
+    size_t count = vc->esc_count + 1;
+    uint16_t n = p[0] ? p[0] : 1;
+    uint8_t* row = &vc->cursor_row;
+    uint8_t* col = &vc->cursor_col;
+
+    switch (final) {
+        case 'A':   // Cursor up
+            *row = n < *row ? *row - n : 0;
+            break;
+        case 'B':   // Cursor down
+            *row = *row + n < VGA_HEIGHT ? *row + n : VGA_HEIGHT - 1;
+            break;
+        case 'C':   // Cursor forward
+            *col = *col + n < VGA_WIDTH ? *col + n : VGA_WIDTH - 1;
+            break;
+        case 'D':   // Cursor back
+            *col = n < *col ? *col - n : 0;
+            break;
+        case 'G':   // Cursor to column
+            *col = n <= VGA_WIDTH ? n - 1 : VGA_WIDTH - 1;
+            break;
+        case 'H':   // Cursor to row;column
+        case 'f':
+            *row = n <= VGA_HEIGHT ? n - 1 : VGA_HEIGHT - 1;
+            n = count > 1 && p[1] ? p[1] : 1;
+            *col = n <= VGA_WIDTH ? n - 1 : VGA_WIDTH - 1;
+            break;
+        case 'J':   // Erase in display: 0 below, 1 above, 2 all
+            if (p[0] == 0) {
+                erase(vc, *row, *col, VGA_WIDTH);
+                for (size_t y = *row + 1; y < VGA_HEIGHT; y++) {
+                    erase(vc, y, 0, VGA_WIDTH);
+                }
+            } else if (p[0] == 1) {
+                for (size_t y = 0; y < *row; y++) {
+                    erase(vc, y, 0, VGA_WIDTH);
+                }
+                erase(vc, *row, 0, *col + 1);
+            } else if (p[0] == 2) {
+                for (size_t y = 0; y < VGA_HEIGHT; y++) {
+                    erase(vc, y, 0, VGA_WIDTH);
+                }
+            }
+            break;
+        case 'K':   // Erase in line: 0 to the right, 1 to the left, 2 all
+            if (p[0] == 0) {
+                erase(vc, *row, *col, VGA_WIDTH);
+            } else if (p[0] == 1) {
+                erase(vc, *row, 0, *col + 1);
+            } else if (p[0] == 2) {
+                erase(vc, *row, 0, VGA_WIDTH);
+            }
+            break;
+        case '@':   // Insert blanks, shifting the rest of the line right
+        case 'P': { // Delete characters, shifting the rest left
+            uint16_t* line = console_row(vc, *row);
+            size_t room = VGA_WIDTH - *col;
+            size_t shift = n < room ? n : room;
+            if (final == '@') {
+                memmove(&line[*col + shift], &line[*col], (room - shift) * sizeof(uint16_t));
+                erase(vc, *row, *col, *col + shift);
+            } else {
+                memmove(&line[*col], &line[*col + shift], (room - shift) * sizeof(uint16_t));
+                erase(vc, *row, VGA_WIDTH - shift, VGA_WIDTH);
+            }
+            break;
+        }
+        case 'm':
+            select_graphics(vc, p, count);
+            break;
+        case 's':
+            vc->saved_row = *row;
+            vc->saved_col = *col;
+            break;
+        case 'u':
+            *row = vc->saved_row;
+            *col = vc->saved_col;
+            break;
+        default:
+            break;  // Unsupported: ignore the whole sequence
+    }
+}
+
+// Feed one byte of an escape sequence to the parser
+static void escape(struct vconsole* vc, char c) {
+    if (vc->esc_state == ESC_START) {
+        vc->esc_state = ESC_NONE;
+        if (c == '[') {
+            vc->esc_state = ESC_CSI;
+            vc->esc_count = 0;
+            memset(vc->esc_params, 0, sizeof(vc->esc_params));
+        } else if (c == '7') {
+            vc->saved_row = vc->cursor_row;
+            vc->saved_col = vc->cursor_col;
+        } else if (c == '8') {
+            vc->cursor_row = vc->saved_row;
+            vc->cursor_col = vc->saved_col;
+        }
+        return;
+    }
+
+    // ESC_CSI: parameters, then one final byte
+    if (c >= '0' && c <= '9') {
+        uint16_t* param = &vc->esc_params[vc->esc_count];
+        if (*param < 1000) {
+            *param = *param * 10 + (c - '0');
+        }
+    } else if (c == ';') {
+        if (vc->esc_count < ESC_MAX_PARAMS - 1) {
+            vc->esc_count++;
+        }
+    } else if (c >= 0x40 && c <= 0x7E) {
+        vc->esc_state = ESC_NONE;
+        control_sequence(vc, c);
+    } else if (c < 0x20 || c > 0x3F) {
+        vc->esc_state = ESC_NONE;   // Not a sequence after all
+    }
+}
+
+// Write single character to a console PLUS spechial chars!! uwu
+// (without touching the screen). Understands the ANSI escape sequences
+// handled by control_sequence(), so the same byte stream can go to the
+// serial console.
+static void put_char(struct vconsole* vc, char c) {
+    if (vc->esc_state != ESC_NONE) {
+        escape(vc, c);
+        return;
+    }
+
     switch (c) {
+        case '\x1b':
+            vc->esc_state = ESC_START;
+            break;
+        case '\b':
+            if (vc->cursor_col > 0) {
+                vc->cursor_col--;
+            }
+            break;
         case '\n':
-            cursor_col = 0;
-            cursor_row++;
+            vc->cursor_col = 0;
+            vc->cursor_row++;
             break;
         case '\r':
-            cursor_col = 0;
+            vc->cursor_col = 0;
             break;
         case '\t':
-            cursor_col = (cursor_col + 4) & ~(4 - 1);  // tab stops every 4 cols
-            if (cursor_col >= VGA_WIDTH) {
-                cursor_col = 0;
-                cursor_row++;
+            vc->cursor_col = (vc->cursor_col + 4) & ~(4 - 1);  // tab stops every 4 cols
+            if (vc->cursor_col >= VGA_WIDTH) {
+                vc->cursor_col = 0;
+                vc->cursor_row++;
             }
             break;
         default:
             if (c >= ' ') {
-                size_t index = cursor_row * VGA_WIDTH + cursor_col;
-                video_mem[index] = vga_entry(c, vga_color);
-                cursor_col++;
-                if (cursor_col >= VGA_WIDTH) {
-                    cursor_col = 0;
-                    cursor_row++;
+                console_row(vc, vc->cursor_row)[vc->cursor_col] = vga_entry(c, vc->color);
+                vc->dirty_rows |= 1u << vc->cursor_row;
+                vc->cursor_col++;
+                if (vc->cursor_col >= VGA_WIDTH) {
+                    vc->cursor_col = 0;
+                    vc->cursor_row++;
                 }
             }
             break;
     }
 
-    if (cursor_row >= VGA_HEIGHT) {
-        vga_scroll();
+    if (vc->cursor_row >= VGA_HEIGHT) {
+        scroll(vc);
     }
+}
 
-    update_cursor();
+void vga_putc(char c) {
+    put_char(kcon, c);
+    if (kcon == shown) {
+        vga_flush();
+    }
+}
+
+// Write len characters to console n; the screen and cursor are updated
+// once, at the end, and only if that console is on screen
+void vga_console_write(unsigned n, const char* buf, size_t len) {
+    if (n >= VGA_CONSOLES) {
+        return;
+    }
+    struct vconsole* vc = &consoles[n];
+    vc->used = true;
+    for (size_t i = 0; i < len; i++) {
+        put_char(vc, buf[i]);
+    }
+    if (vc == shown) {
+        vga_flush();
+    }
+}
+
+void vga_write(const char* buf, size_t len) {
+    vga_console_write(0, buf, len);
 }
 
 // Write null-terminated string
 void vga_puts(const char* str) {
     if (!str) return;
-    while (*str) {
-        vga_putc(*str++);
+    size_t len = 0;
+    while (str[len]) {
+        len++;
     }
+    vga_write(str, len);
 }
 
 // Print 32-bit unsigned integer in hex
 void vga_puthex(uint32_t num) {
-    const char* hex_chars = "0123456789ABCDEF";
     char buf[9];
-    buf[8] = '\0';
-    for (int i = 7; i >= 0; i--) {
-        buf[i] = hex_chars[num & 0xF];
-        num >>= 4;
-    }
+    kfmt_hex(buf, num, 8);
     vga_puts(buf);
 }
 
 // Print 32-bit unsigned integer in decimal
 void vga_putdec(uint32_t num) {
     char buf[11]; // enough for 10 digits + null
-    int i = 10;
-    buf[i] = '\0';
-
-    if (num == 0) {
-        vga_putc('0');
-        return;
-    }
-
-    while (num > 0 && i) {
-        buf[--i] = '0' + (num % 10);
-        num /= 10;
-    }
-
-    vga_puts(&buf[i]);
+    kfmt_dec(buf, num);
+    vga_puts(buf);
 }
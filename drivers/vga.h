@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 // VGA colors baby!!
 enum vga_color {
@@ -24,16 +25,37 @@ enum vga_color {
     VGA_COLOR_WHITE = 15,
 };
 
+// Virtual consoles, switched with Alt+F1..F6. The calls below without a
+// console number act on console 0, the kernel console, which also holds
+// the shell. Only consoles that have been written to can be switched to
+// (console 5 carries the kernel log), and typed keys only reach the shell
+// while console 0 is shown.
+#define VGA_CONSOLES 6
+
 void vga_clear();
 void vga_set_color(uint8_t fg, uint8_t bg);
 void vga_get_color(uint8_t* fg, uint8_t* bg);
 void vga_putc(char c);
 void vga_puts(const char* str);
+void vga_write(const char* buf, size_t len);
 void vga_puthex(uint32_t num);
 void vga_putdec(uint32_t n);
 void vga_move_cursor(uint8_t row, uint8_t col);
 void vga_get_cursor(uint8_t* row, uint8_t* col);
 void vga_scroll();
+void vga_flush();
+
+// Write to console n; nothing reaches video memory unless it is shown
+void vga_console_write(unsigned n, const char* buf, size_t len);
+
+// Scrollback: move the view by steps half screens (positive: older
+// output). These may be called from interrupt handlers; the screen
+// changes at the next flush or vga_poll(), which returns whether it had
+// work.
+void vga_scroll_view(int steps);
+void vga_console_switch(unsigned n);
+unsigned vga_console_shown();
+bool vga_poll();
 void vga_enable_cursor(uint8_t cursor_start, uint8_t cursor_end);
 void vga_disable_cursor();
 
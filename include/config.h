@@ -4,8 +4,9 @@
 // Kernel configuration options
 
 // Memory management
-#define KERNEL_HEAP_SIZE 0x100000  // 1MB heap for kernel
-#define PAGE_SIZE        4096      // 4KB pages
+#define KERNEL_HEAP_INITIAL 0x10000    // 64KB of heap mapped at boot
+#define KERNEL_HEAP_MAX     0x1000000  // Heap may grow to 16MB
+#define PAGE_SIZE           4096       // 4KB pages
 
 // VGA settings
 #define VGA_WIDTH   80
@@ -226,6 +226,9 @@ extern void irq15(void);
 static inline void cli(void) { asm volatile("cli"); }
 static inline void sti(void) { asm volatile("sti"); }
 
+// True while an IRQ handler is running
+bool in_interrupt(void);
+
 // Helper macros for interrupt control
 #define IRQ_OFF() cli()
 #define IRQ_ON()  sti()
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include "interrupts.h"
 
 // Kernel version
@@ -40,6 +41,19 @@ void panic(const char* message);
 // Kernel entry point (defined in kernel.c)
 __attribute__((noreturn)) extern void _kernel_main(void);
 
+// Console output (VGA and COM1)
+void kprint(const char* str);
+
+// Formatted output: %d %i %u %x %X %p %s %c %%, with the l, ll, z and h
+// size modifiers, '-' and '0' flags, a width and a string precision.
+// kprintf() formats into a stack buffer and logs the whole message at
+// once (see kernel/klog.h); the ksnprintf() family truncates to size and
+// returns the length the full message would have had.
+int kprintf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+int kvprintf(const char* fmt, va_list args);
+int ksnprintf(char* buf, size_t size, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+int kvsnprintf(char* buf, size_t size, const char* fmt, va_list args);
+
 // VGA functions
 void vga_clear(void);
 void vga_set_color(uint8_t fg, uint8_t bg);
@@ -66,10 +80,12 @@ void register_interrupt_handler(uint8_t n, isr_t handler);
 
 // Utility functions
 void halt(void);
+void idle(void);    // Background work, or hlt when there is none
 void cli(void);
 void sti(void);
 
 // Memory management
+void mm_initialize(void);
 void* kmalloc(size_t size);
 void kfree(void* ptr);
 
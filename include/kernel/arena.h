@@ -0,0 +1,39 @@
+#ifndef KERNEL_ARENA_H
+#define KERNEL_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Bump allocators for short-lived scratch memory. Allocations are carved
+// from chunks obtained from kmalloc and are never freed one by one:
+// arena_reset() drops everything at once and keeps a chunk for reuse, so
+// an arena that is reset after every job stops touching the heap.
+
+typedef struct arena arena_t;
+
+// Position in an arena, for releasing a scope's allocations early
+typedef struct {
+    void* chunk;
+    size_t used;
+} arena_mark_t;
+
+// Create an arena whose chunks hold chunk_size bytes (0 = default)
+arena_t* arena_create(size_t chunk_size);
+
+// Free the arena and all its chunks
+void arena_destroy(arena_t* arena);
+
+// Allocate size bytes, 8-byte aligned, or NULL when out of memory
+void* arena_alloc(arena_t* arena, size_t size);
+
+// Copy at most n characters of str into the arena, NUL-terminated
+char* arena_strndup(arena_t* arena, const char* str, size_t n);
+
+// Drop every allocation; one chunk is kept for the next round
+void arena_reset(arena_t* arena);
+
+// Remember the current position / drop everything allocated after it
+arena_mark_t arena_mark(arena_t* arena);
+void arena_release(arena_t* arena, arena_mark_t mark);
+
+#endif // KERNEL_ARENA_H
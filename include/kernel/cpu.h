@@ -0,0 +1,85 @@
+#ifndef KERNEL_CPU_H
+#define KERNEL_CPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// CR0 bits
+#define CR0_PG (1u << 31)   // Paging enable
+#define CR0_WP (1u << 16)   // Honour read-only pages in ring 0
+#define CR0_TS (1u << 3)    // Task switched: FPU/SSE use traps
+#define CR0_EM (1u << 2)    // Emulate the FPU (no FPU/SSE instructions)
+#define CR0_MP (1u << 1)    // Monitor coprocessor
+
+// CR4 bits
+#define CR4_PSE (1u << 4)   // 4MB pages
+#define CR4_PGE (1u << 7)   // Global pages
+#define CR4_OSFXSR (1u << 9)        // OS saves SSE state with fxsave
+#define CR4_OSXMMEXCPT (1u << 10)   // OS handles SIMD exceptions (#XM)
+
+// CPUID leaf 1 EDX feature bits
+#define CPUID_EDX_PSE (1u << 3)
+#define CPUID_EDX_PGE (1u << 13)
+#define CPUID_EDX_FXSR (1u << 24)
+#define CPUID_EDX_SSE (1u << 25)
+#define CPUID_EDX_SSE2 (1u << 26)
+
+// Execute CPUID for the given leaf
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile("cpuid"
+                     : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                     : "a"(leaf), "c"(0));
+}
+
+// Control register access
+static inline uint32_t read_cr0(void) {
+    uint32_t val;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr0(uint32_t val) {
+    __asm__ volatile("mov %0, %%cr0" : : "r"(val) : "memory");
+}
+
+static inline uint32_t read_cr2(void) {
+    uint32_t val;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(val));
+    return val;
+}
+
+static inline uint32_t read_cr3(void) {
+    uint32_t val;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr3(uint32_t val) {
+    __asm__ volatile("mov %0, %%cr3" : : "r"(val) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t val;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr4(uint32_t val) {
+    __asm__ volatile("mov %0, %%cr4" : : "r"(val) : "memory");
+}
+
+// Save/restore the FPU and SSE state (512 bytes, 16-byte aligned)
+static inline void fxsave(void* area) {
+    __asm__ volatile("fxsave (%0)" : : "r"(area) : "memory");
+}
+
+static inline void fxrstor(void* area) {
+    __asm__ volatile("fxrstor (%0)" : : "r"(area) : "memory");
+}
+
+// Drop the TLB entry for a single page
+static inline void invlpg(void* addr) {
+    __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+#endif // KERNEL_CPU_H
@@ -0,0 +1,25 @@
+#ifndef KERNEL_KLOG_H
+#define KERNEL_KLOG_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Kernel log ring. Console output is appended here in constant time from
+// any context, interrupt handlers included, and written to VGA and COM1
+// later by whoever drains the ring: kprint() when called outside an
+// interrupt, and the idle loop for everything logged by handlers.
+
+// Append len bytes. Never blocks; when the ring is full the message is
+// dropped and counted instead.
+void klog_write(const char* buf, size_t len);
+
+// Write everything committed so far to the consoles. Returns false at
+// once if there was nothing to do or another drain is running. Not for
+// interrupt handlers.
+bool klog_drain(void);
+
+// Write out whatever is left, synchronously and ignoring a drain that was
+// interrupted. For panic(), with interrupts off.
+void klog_flush(void);
+
+#endif // KERNEL_KLOG_H
@@ -4,9 +4,25 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "../config.h"
 
-// Kernel heap size (4MB)
-#define KERNEL_HEAP_SIZE (4 * 1024 * 1024)
+// Physical memory above this address is not managed (it stays outside the
+// kernel's direct map)
+#define MM_PHYS_LIMIT 0x40000000
+
+// The kernel heap lives in its own virtual window and is backed by frames
+// on demand, KERNEL_HEAP_INITIAL bytes at boot and up to KERNEL_HEAP_MAX
+#define KERNEL_HEAP_START 0xC0000000
+
+// Largest buddy block is 2^PFA_MAX_ORDER frames (4MB)
+#define PFA_MAX_ORDER 10
+
+// Small allocations are served from power-of-two size classes (16..512 bytes)
+#define MM_SIZE_CLASSES 6
+#define MM_SMALL_MAX    512
+
+// kmalloc size histogram: 16, 32, ... 16K bytes and larger
+#define MM_HIST_BUCKETS 12
 
 // Memory map entry types
 #define MEMORY_FREE 1
@@ -23,19 +39,25 @@ typedef struct {
     uint32_t acpi_attrs;
 } __attribute__((packed)) memory_map_entry_t;
 
-// Memory block header
+// Memory block header (prev_size is the boundary tag of the block below)
 struct memory_block {
     size_t size;
+    size_t prev_size;
     bool free;
     struct memory_block *next;
 } __attribute__((packed));
 
 typedef struct memory_block memory_block_t;
 
-// Initialize memory manager
+// Initialize memory manager (mem_upper: KB of memory above 1MB, used when
+// no memory map was registered through mm_add_region). Neither boot path
+// hands the kernel a BIOS map, so mm_initialize sizes memory from the CMOS.
 void mm_init(uintptr_t mem_upper);
+void mm_initialize(void);
 
-// Memory allocation functions
+// Memory allocation functions. From an IRQ handler kmalloc only serves
+// requests up to MM_SMALL_MAX (from a small reserve), kfree is deferred and
+// krealloc only works on NULL.
 void* kmalloc(size_t size);
 void* kcalloc(size_t num, size_t size);
 void* krealloc(void* ptr, size_t size);
@@ -51,6 +73,7 @@ void* kmemmove(void* dest, const void* src, size_t num);
 void mm_print_map(void);
 void mm_add_region(uintptr_t base, size_t size, uint32_t type);
 void mm_remove_region(uintptr_t base, size_t size);
+bool mm_have_memory_map(void);
 
 // Memory statistics
 typedef struct {
@@ -60,23 +83,113 @@ typedef struct {
     size_t block_count;
     size_t alloc_count;
     size_t free_count;
+    size_t bytes_in_use;                    // Bytes handed out right now
+    size_t peak_in_use;                     // High-water mark of bytes_in_use
+    size_t size_hist[MM_HIST_BUCKETS];      // Requests up to 16 << i bytes
+    size_t class_size[MM_SIZE_CLASSES];    // Object size of each class
+    size_t class_hits[MM_SIZE_CLASSES];    // Served from a partial slab
+    size_t class_misses[MM_SIZE_CLASSES];  // Needed a new slab
+    size_t class_slabs[MM_SIZE_CLASSES];   // Slabs currently owned by the class
+    size_t phys_total;                      // Bytes managed by the frame allocator
+    size_t phys_free;                       // Bytes of free frames
+    size_t realloc_inplace;                 // krealloc calls that didn't move
+    size_t realloc_moved;                   // krealloc calls that had to copy
+    size_t largest_free;                    // Largest free heap block
+    size_t max_walk;                        // Longest first-fit block list walk
+    size_t irq_alloc_count;                 // kmalloc calls served in interrupt context
+    size_t irq_alloc_failed;                // ...and those that found the reserve empty
+    size_t zero_pool;                       // Pre-zeroed frames ready for use
+    size_t zero_hits;                       // Zeroed frames served from the pool
+    size_t zero_misses;                     // ...and those cleared on demand
 } memory_stats_t;
 
 void mm_get_stats(memory_stats_t* stats);
 
-// Page frame allocator
+// Page frame allocator (binary buddy over the boot memory map)
 void pfa_init(void);
 void* pfa_alloc(void);
+void* pfa_alloc_order(unsigned order);
+void* pfa_alloc_zeroed(void);
+bool pfa_zero_idle(void);
+void pfa_zero_stats(size_t* pooled, size_t* hits, size_t* misses);
 void pfa_free(void* page);
-
-// Virtual memory functions
+bool pfa_ref(void* page);
+unsigned pfa_refcount(void* page);
+size_t pfa_total_frames(void);
+size_t pfa_free_frames(void);
+uintptr_t pfa_max_address(void);
+
+// Page table entry flags
+#define VMM_PRESENT 0x001
+#define VMM_WRITE   0x002
+#define VMM_USER    0x004
+#define VMM_LARGE   0x080   // 4MB page (page directory entries only)
+#define VMM_GLOBAL  0x100
+#define VMM_COW     0x200   // Shared read-only until written (available bit)
+
+// Virtual memory functions. Physical memory up to MM_PHYS_LIMIT is identity
+// mapped with global 4MB pages; vmm_map_page() works on addresses above it.
 void vmm_init(void);
 void* vmm_alloc_page(void);
 void vmm_free_page(void* page);
 void* vmm_map_page(void* phys, void* virt);
+void* vmm_map_page_flags(void* phys, void* virt, uint32_t flags);
 void vmm_unmap_page(void* virt);
-
-// Heap functions
+void vmm_unmap_range(void* virt, size_t length);
+uintptr_t vmm_get_physical(void* virt);
+
+// Address spaces. Kernel mappings are shared by every page directory; the
+// user range (MM_USER_START..MM_USER_END) is cloned copy-on-write: both
+// sides map the same frames read-only and a write fault copies the page.
+uint32_t* vmm_clone(void);
+void vmm_destroy(uint32_t* dir);
+void vmm_switch(uint32_t* dir);
+uint32_t* vmm_current(void);
+bool vmm_handle_cow(void* virt);
+
+// Demand-zero areas. Between MM_USER_START and MM_USER_END, virtual memory
+// can be reserved without backing it; each page gets a zeroed frame when it
+// is first touched. sys_sbrk grows from MM_USER_START, sys_mmap places its
+// areas from MM_MMAP_START up.
+#define MM_USER_START   MM_PHYS_LIMIT
+#define MM_MMAP_START   0x80000000
+#define MM_USER_END     KERNEL_HEAP_START
+
+#define VMA_READ    0x1
+#define VMA_WRITE   0x2
+#define VMA_MAX     64      // Areas per address space
+
+struct vm_area {
+    uintptr_t start;
+    uintptr_t end;
+    uint32_t prot;
+};
+
+// A user address space: its page directory, its areas (sorted by start
+// address, never overlapping) and its program break. The vma_* calls and
+// the page-fault handler work on the current one.
+typedef struct mm_space {
+    uint32_t *dir;
+    struct vm_area areas[VMA_MAX];
+    size_t area_count;
+    uintptr_t brk;
+} mm_space_t;
+
+void vma_init(void);
+void* vma_reserve(void* addr, size_t length, uint32_t prot);
+int vma_release(void* addr, size_t length);
+void* vma_replace(void* addr, size_t length, uint32_t prot);
+
+mm_space_t* mm_space_current(void);
+mm_space_t* mm_space_clone(void);
+void mm_space_destroy(mm_space_t* s);
+void mm_space_switch(mm_space_t* s);
+
+// Heap functions (the block allocator behind large kmalloc requests).
+// When no free block fits, the heap grows by whole pages, at least four at
+// a time. Pages above its recent peak size that are free at the top go
+// back to the frame allocator 16 or more at a time; the peak decays as
+// the heap stays small, so a heap that shrinks and regrows keeps its pages.
 void heap_init(void);
 void* heap_alloc(size_t size);
 void heap_free(void* ptr);
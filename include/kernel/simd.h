@@ -0,0 +1,25 @@
+#ifndef KERNEL_SIMD_H
+#define KERNEL_SIMD_H
+
+#include <stdbool.h>
+
+// Kernel use of SSE. Nothing in the kernel is compiled to use SSE, so the
+// XMM registers belong to whoever ran last; kernel code that wants them
+// brackets its use with kernel_simd_begin()/kernel_simd_end(), which save
+// and restore the full FPU/SSE state.
+
+// Enable SSE if the CPU has SSE2 and route large memcpy/memset/memcmp/
+// memchr calls through the SSE2 versions
+void simd_init(void);
+
+// Was SSE2 enabled by simd_init()?
+bool simd_enabled(void);
+
+// Claim the XMM registers. Fails inside interrupt handlers and while
+// another claim is active; the caller then falls back to scalar code.
+bool kernel_simd_begin(void);
+
+// Restore the state saved by a successful kernel_simd_begin()
+void kernel_simd_end(void);
+
+#endif // KERNEL_SIMD_H
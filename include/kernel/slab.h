@@ -0,0 +1,50 @@
+#ifndef KERNEL_SLAB_H
+#define KERNEL_SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Typed object caches. Each cache hands out fixed-size objects from slabs
+// of page frames. Objects are constructed once when their slab is created
+// and must be returned to the cache in their constructed state.
+
+typedef struct kmem_cache kmem_cache_t;
+
+// Per-cache occupancy statistics
+typedef struct {
+    const char* name;
+    size_t object_size;     // Requested object size
+    size_t slot_size;       // Bytes each object occupies in a slab
+    size_t slab_pages;      // Pages per slab
+    size_t objects_total;   // Objects carved from all slabs
+    size_t objects_inuse;   // Objects currently allocated
+    size_t slabs_full;
+    size_t slabs_partial;
+    size_t slabs_empty;
+    size_t alloc_count;
+    size_t free_count;
+} kmem_cache_stats_t;
+
+// Create a cache of objects of the given size and alignment (0 = default).
+// ctor, if set, runs once on every object when its slab is created.
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, void (*ctor)(void*));
+
+// Release all slabs and the cache itself (every object must be freed)
+void kmem_cache_destroy(kmem_cache_t* cache);
+
+// Allocate a constructed object, or NULL when out of memory
+void* kmem_cache_alloc(kmem_cache_t* cache);
+
+// Return an object (in its constructed state) to its cache
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+// Give every empty slab back to the page allocator
+void kmem_cache_shrink(kmem_cache_t* cache);
+
+// Occupancy statistics for one cache
+void kmem_cache_get_stats(kmem_cache_t* cache, kmem_cache_stats_t* stats);
+
+// Iterate over all caches (pass NULL to get the first)
+kmem_cache_t* kmem_cache_next(kmem_cache_t* cache);
+
+#endif // KERNEL_SLAB_H
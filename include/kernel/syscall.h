@@ -3,6 +3,24 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "../types.h"
+
+struct dirent;
+struct stat;
+
+// sys_mmap protection bits
+#define PROT_NONE  0x0
+#define PROT_READ  0x1
+#define PROT_WRITE 0x2
+#define PROT_EXEC  0x4
+
+// sys_mmap flags (only anonymous mappings are supported)
+#define MAP_SHARED    0x01
+#define MAP_PRIVATE   0x02
+#define MAP_FIXED     0x10
+#define MAP_ANONYMOUS 0x20
+
+#define MAP_FAILED ((void*)-1)
 
 // System call numbers
 enum {
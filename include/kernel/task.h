@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+struct mm_space;
+
 // Process states
 typedef enum {
     TASK_RUNNING,     // Currently executing
@@ -24,7 +26,7 @@ typedef enum {
 } task_priority_t;
 
 // CPU context structure
-typef struct {
+typedef struct {
     uint32_t eax;
     uint32_t ebx;
     uint32_t ecx;
@@ -54,6 +56,7 @@ typedef struct task_control_block {
     uint32_t kernel_stack;          // Kernel stack pointer
     uint32_t user_stack;            // User stack pointer
     uint32_t page_directory;        // Page directory physical address
+    struct mm_space* space;         // Address space (areas, break, directory)
     uint32_t time_slice;            // Remaining time slice
     uint32_t wakeup_time;           // Time to wake up (for sleep)
     struct task_control_block* next; // Next task in the list
@@ -70,6 +73,13 @@ int task_create(void (*entry)(void), const char* name, task_priority_t priority)
 // Get the current task
 task_t* task_current(void);
 
+// Fork the current task: the child gets a copy-on-write clone of its
+// address space and is left READY
+task_t* task_fork(void);
+
+// Free a task that isn't running, together with its address space
+void task_destroy(task_t* task);
+
 // Yield the CPU to the next task
 void task_yield(void);
 
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 // String functions
 size_t kstrlen(const char* str);
@@ -31,12 +32,22 @@ long long katoll(const char* str);
 unsigned long katoul(const char* str);
 unsigned long long katoull(const char* str);
 char* kitoa(int value, char* str, int base);
-char* kitoa(int value, char* str, int base);
 char* kltoa(long value, char* str, int base);
 char* klltoa(long long value, char* str, int base);
 char* kultoa(unsigned long value, char* str, int base);
 char* kulltoa(unsigned long long value, char* str, int base);
 
+// Number formatting for the console, serial and panic paths. Each writes
+// a NUL-terminated string to buf and returns its length (without the NUL).
+size_t kfmt_dec(char* buf, uint32_t value);             // buf: 11 bytes
+size_t kfmt_dec64(char* buf, uint64_t value);           // buf: 21 bytes
+size_t kfmt_hex(char* buf, uint32_t value, int width);  // buf: 9 bytes
+size_t kfmt_hex64(char* buf, uint64_t value, int width);// buf: 17 bytes
+
+// Divide *n by base in place and return the remainder, with 32-bit
+// divisions only (the kernel isn't linked against libgcc's __udivdi3)
+uint32_t kdiv64(uint64_t* n, uint32_t base);
+
 // Character functions
 int kisalpha(int c);
 int kisdigit(int c);
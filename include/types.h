@@ -0,0 +1,15 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// POSIX-style types shared by the system call and VFS interfaces
+typedef int32_t off_t;
+typedef int32_t pid_t;
+typedef uint32_t uid_t;
+typedef uint32_t gid_t;
+typedef uint32_t mode_t;
+
+#endif // TYPES_H
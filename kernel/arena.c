@@ -0,0 +1,148 @@
+#include "../include/kernel.h"
+#include "../include/kernel/mm.h"
+#include "../include/kernel/arena.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Chunks are kept newest first. A request that doesn't fit the current
+// chunk starts a new one; requests larger than a whole chunk get a chunk
+// of their own.
+
+#define ARENA_ALIGN         8
+#define ARENA_DEFAULT_CHUNK (PAGE_SIZE - 64)
+
+struct arena_chunk {
+    struct arena_chunk *next;   // Next older chunk
+    size_t size;                // Usable bytes in data[]
+    size_t used;
+    uint8_t data[] __attribute__((aligned(ARENA_ALIGN)));  // Not just 4 on i386
+};
+
+struct arena {
+    struct arena_chunk *head;   // Chunk currently being filled
+    size_t chunk_size;
+};
+
+// Largest size align_up() can round without wrapping
+#define ARENA_SIZE_MAX (SIZE_MAX - (ARENA_ALIGN - 1))
+
+static inline size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static struct arena_chunk* chunk_new(size_t size) {
+    if (size > SIZE_MAX - sizeof(struct arena_chunk)) {
+        return NULL;
+    }
+    struct arena_chunk *c = kmalloc(sizeof(struct arena_chunk) + size);
+    if (c == NULL) {
+        return NULL;
+    }
+    c->next = NULL;
+    c->size = size;
+    c->used = 0;
+    return c;
+}
+
+arena_t* arena_create(size_t chunk_size) {
+    if (chunk_size > ARENA_SIZE_MAX) {
+        return NULL;
+    }
+    struct arena *a = kmalloc(sizeof(struct arena));
+    if (a == NULL) {
+        return NULL;
+    }
+    a->chunk_size = chunk_size ? align_up(chunk_size) : ARENA_DEFAULT_CHUNK;
+    a->head = NULL;
+    return a;
+}
+
+void arena_destroy(arena_t* arena) {
+    if (arena == NULL) {
+        return;
+    }
+    while (arena->head != NULL) {
+        struct arena_chunk *c = arena->head;
+        arena->head = c->next;
+        kfree(c);
+    }
+    kfree(arena);
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    struct arena_chunk *c = arena->head;
+
+    if (size > ARENA_SIZE_MAX) {
+        return NULL;
+    }
+    size = align_up(size ? size : 1);
+    if (c != NULL && c->size - c->used >= size) {
+        void *p = c->data + c->used;
+        c->used += size;
+        return p;
+    }
+
+    c = chunk_new(size > arena->chunk_size ? size : arena->chunk_size);
+    if (c == NULL) {
+        return NULL;
+    }
+    c->next = arena->head;
+    arena->head = c;
+    c->used = size;
+    return c->data;
+}
+
+char* arena_strndup(arena_t* arena, const char* str, size_t n) {
+    size_t len = 0;
+    while (len < n && str[len]) {
+        len++;
+    }
+
+    char *copy = arena_alloc(arena, len + 1);
+    if (copy != NULL) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+// Free chunks newer than keep (NULL frees them all)
+static void free_chunks_above(struct arena *a, struct arena_chunk *keep) {
+    while (a->head != keep) {
+        struct arena_chunk *c = a->head;
+        a->head = c->next;
+        kfree(c);
+    }
+}
+
+void arena_reset(arena_t* arena) {
+    // The oldest chunk is kept if it has the regular size
+    struct arena_chunk *oldest = arena->head;
+    while (oldest != NULL && oldest->next != NULL) {
+        oldest = oldest->next;
+    }
+    if (oldest != NULL && oldest->size != arena->chunk_size) {
+        oldest = NULL;
+    }
+
+    free_chunks_above(arena, oldest);
+    if (oldest != NULL) {
+        oldest->used = 0;
+    }
+}
+
+arena_mark_t arena_mark(arena_t* arena) {
+    arena_mark_t mark;
+    mark.chunk = arena->head;
+    mark.used = arena->head ? arena->head->used : 0;
+    return mark;
+}
+
+void arena_release(arena_t* arena, arena_mark_t mark) {
+    free_chunks_above(arena, mark.chunk);
+    if (arena->head != NULL) {
+        arena->head->used = mark.used;
+    }
+}
@@ -6,7 +6,7 @@
 #include "../include/kernel/pic.h"
 #include "../include/interrupts.h"
 #include "../drivers/serial.h"
-#include "../include/kernel.h"  // For panic()
+#include "../include/kernel.h"  // For panic() and ksnprintf()
 
 // Ensure NULL is defined if not already
 #ifndef NULL
@@ -19,6 +19,9 @@ idt_entry_t idt[IDT_ENTRIES];
 // ISR handler function pointers
 static isr_t interrupt_handlers[IDT_ENTRIES];
 
+// Number of IRQ handlers currently running
+static volatile uint32_t irq_depth;
+
 // External declarations for assembly functions
 typedef void (*isr_handler_t)(void);
 extern isr_handler_t _isr_handlers[];
@@ -30,54 +33,11 @@ void default_interrupt_handler(registers_t *r) {
     // Don't panic for spurious IRQs or IRQs that might be handled by drivers
     if (r->int_no < 32) {
         char buf[32];
-        const char *msg = "Unhandled exception ";
-        char *ptr = buf;
-        
-        // Copy the message
-        while (*msg) {
-            *ptr++ = *msg++;
-        }
-        
-        // Convert the number to string
-        int num = r->int_no;
-        char num_buf[16];
-        char *num_ptr = num_buf;
-        
-        if (num == 0) {
-            *num_ptr++ = '0';
-        } else {
-            // Convert number to string (reversed)
-            while (num > 0) {
-                *num_ptr++ = '0' + (num % 10);
-                num /= 10;
-            }
-            // Reverse the number string
-            char *start = num_buf;
-            char *end = num_ptr - 1;
-            while (start < end) {
-                char tmp = *start;
-                *start = *end;
-                *end = tmp;
-                start++;
-                end--;
-            }
-        }
-        *num_ptr = '\0';
-        
-        // Copy the number
-        char *tmp = num_buf;
-        while (*tmp) {
-            *ptr++ = *tmp++;
-        }
-        *ptr = '\0';
-        
+        ksnprintf(buf, sizeof(buf), "Unhandled exception %u", r->int_no);
         panic(buf);
     } else if (r->int_no >= 32 && r->int_no < 48) {
         // This is an IRQ, just log it
-        serial_write_string(SERIAL_COM1_BASE, "Unhandled IRQ: ");
-        serial_write_byte(SERIAL_COM1_BASE, '0' + ((r->int_no - 32) / 10));
-        serial_write_byte(SERIAL_COM1_BASE, '0' + ((r->int_no - 32) % 10));
-        serial_write_string(SERIAL_COM1_BASE, "\n");
+        kprintf("Unhandled IRQ: %u\n", r->int_no - 32);
     }
     
     // Acknowledge the interrupt
@@ -117,11 +77,18 @@ void _isr_handler(registers_t *regs) {
     }
 }
 
+// Is the CPU servicing an IRQ?
+bool in_interrupt(void) {
+    return irq_depth != 0;
+}
+
 // IRQ handler - called by the assembly IRQ stubs
 void _irq_handler(registers_t *regs) {
     // The IRQ number is stored in regs->int_no - 32
     // Call the ISR handler which will call the appropriate handler
+    irq_depth++;
     _isr_handler(regs);
+    irq_depth--;
     
     // The EOI is sent by the default handler or the specific IRQ handler
 }
@@ -23,11 +23,8 @@ void irq_init(void) {
 
 // Default interrupt handler for unhandled IRQs
 void default_irq_handler(registers_t *regs) {
-    // Log the unhandled IRQ
-    serial_write_string(SERIAL_COM1_BASE, "Unhandled IRQ: ");
-    serial_write_byte(SERIAL_COM1_BASE, '0' + ((regs->int_no - 32) / 10));
-    serial_write_byte(SERIAL_COM1_BASE, '0' + ((regs->int_no - 32) % 10));
-    serial_write_string(SERIAL_COM1_BASE, "\n");
+    // Log the unhandled IRQ (written out later, from the idle loop)
+    kprintf("Unhandled IRQ: %u\n", regs->int_no - 32);
     
     // Acknowledge the interrupt
     if (regs->int_no >= 40) {
@@ -2,14 +2,69 @@
 #include "config.h"
 #include "../drivers/vga.h"
 #include "../drivers/serial.h"
+#include "kernel/mm.h"
+#include "kernel/simd.h"
+#include "kernel/task.h"
+#include "string.h"
 #include "interrupts.h"
 #include <stdint.h>
 
 // Forward declaration
 void irq_init(void);
 
+// Check fork's memory half: fork with a written demand-zero page, write the
+// page from the child's space and make sure the two sides end up on
+// different frames holding their own data
+static bool cow_clone_test(void) {
+    mm_space_t *parent = mm_space_current();
+    volatile uint32_t *page = vma_reserve(NULL, PAGE_SIZE, VMA_READ | VMA_WRITE);
+    bool ok = false;
+
+    if (page == NULL) {
+        return false;
+    }
+    *page = 0x11111111;
+    uintptr_t parent_frame = vmm_get_physical((void*)page);
+
+    task_t *task = task_fork();
+    if (task == NULL) {
+        vma_release((void*)page, PAGE_SIZE);
+        return false;
+    }
+
+    mm_space_t *child = task->space;
+    mm_space_switch(child);
+    bool shared = task->ppid == task_current()->pid && task->state == TASK_READY &&
+                  child->area_count == parent->area_count && child->brk == parent->brk &&
+                  *page == 0x11111111 && vmm_get_physical((void*)page) == parent_frame;
+    *page = 0x22222222;
+    bool split = vmm_get_physical((void*)page) != parent_frame && *page == 0x22222222;
+    mm_space_switch(parent);
+
+    if (shared && split && *page == 0x11111111) {
+        // The parent is now the frame's only user and keeps it on write
+        *page = 0x33333333;
+        ok = vmm_get_physical((void*)page) == parent_frame;
+    }
+
+    task_destroy(task);
+    vma_release((void*)page, PAGE_SIZE);
+    return ok;
+}
+
+// Debug commands, run when Enter is pressed on a console line
+static void console_command(const char *line) {
+    if (strcmp(line, "cowtest") == 0) {
+        vga_puts(cow_clone_test() ? "Copy-on-write clone test passed\n"
+                                  : "Copy-on-write clone test FAILED\n");
+    }
+}
+
 // Simple minimal console
 static void console_loop(void) {
+    char line[64];
+    size_t len = 0;
+
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
 
     while (1) {
@@ -25,24 +80,30 @@ static void console_loop(void) {
             if (c == '\r') {
                 vga_putc('\n');
             }
+
+            if (c == '\n' || c == '\r') {
+                line[len] = '\0';
+                console_command(line);
+                len = 0;
+            } else if (c == '\b') {
+                if (len > 0) {
+                    len--;
+                }
+            } else if (len < sizeof(line) - 1) {
+                line[len++] = c;
+            }
         }
     }
 }
 
 // Default interrupt handler
 static void default_handler(registers_t *regs) {
-    vga_puts("Unhandled interrupt: 0x");
-    vga_puthex(regs->int_no);
-    vga_puts(" (");
-    
     // Print error code if present
     if (regs->err_code != 0xFFFFFFFF) {
-        vga_puthex(regs->err_code);
+        kprintf("Unhandled interrupt: 0x%08X (%08X)\n", regs->int_no, regs->err_code);
     } else {
-        vga_puts("no error code");
+        kprintf("Unhandled interrupt: 0x%08X (no error code)\n", regs->int_no);
     }
-    
-    vga_puts(")\n");
 }
 
 void _kernel_main(void) {
@@ -57,6 +118,12 @@ void _kernel_main(void) {
     serial_init(SERIAL_COM1_BASE, 115200);
     serial_write_string(SERIAL_COM1_BASE, "Serial port ready.\n");
 
+    // Use SSE2 for large memory copies when the CPU has it
+    simd_init();
+
+    // Initialize the frame allocator and kernel heap
+    mm_initialize();
+
     // Initialize IDT, PIC, and IRQ handling
     idt_init();
     irq_init();
@@ -65,6 +132,10 @@ void _kernel_main(void) {
     for (int i = 0; i < 48; i++) {
         register_interrupt_handler(i, default_handler);
     }
+
+    // Page faults back demand-zero memory
+    vma_init();
+    tasking_init();
     
     vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
     vga_puts("Initialization complete!\n");
@@ -78,7 +149,7 @@ void _kernel_main(void) {
     
     // If console_loop somehow returns, enter an infinite loop
     while (1) {
-        __asm__ volatile ("hlt");
+        idle();
     }
     
     // This code should never be reached
@@ -0,0 +1,137 @@
+#include "../include/kernel.h"
+#include "../include/kernel/klog.h"
+#include "../drivers/vga.h"
+#include "../drivers/serial.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Lock-free multi-producer, single-consumer byte ring.
+//
+// A producer reserves space by advancing head with a compare-and-swap,
+// copies its message in and then sets the ready bit in the record header.
+// The consumer writes records out in order from tail and stops at the
+// first one not ready yet (its producer was interrupted before finishing;
+// the next drain picks it up). Consumed space is cleared before tail moves
+// past it, so a reserved but unwritten header always reads as not ready.
+//
+// head and tail run freely and are reduced modulo KLOG_SIZE on access.
+
+#define KLOG_SIZE       16384   // Power of two
+#define KLOG_RECORD_MAX 256     // Longer messages take several records
+#define KLOG_READY      0x80000000u
+#define KLOG_HEADER     sizeof(uint32_t)
+#define KLOG_CONSOLE    (VGA_CONSOLES - 1)  // Alt+F6: the log on its own
+
+static uint8_t ring[KLOG_SIZE] __attribute__((aligned(4)));
+static volatile uint32_t head;      // Next free byte
+static volatile uint32_t tail;      // Oldest record not yet written out
+static volatile uint32_t dropped;   // Messages lost to a full ring
+static volatile int draining;
+
+// Space taken by a record with len bytes of text (headers stay aligned)
+static inline uint32_t record_size(uint32_t len) {
+    return (KLOG_HEADER + len + 3) & ~3u;
+}
+
+static inline uint32_t* header_at(uint32_t pos) {
+    return (uint32_t*)&ring[pos & (KLOG_SIZE - 1)];
+}
+
+static void append(const char* buf, uint32_t len) {
+    uint32_t size = record_size(len);
+    uint32_t pos;
+
+    do {
+        pos = head;
+        if (pos + size - tail > KLOG_SIZE) {
+            __sync_add_and_fetch(&dropped, 1);
+            return;
+        }
+    } while (!__sync_bool_compare_and_swap(&head, pos, pos + size));
+
+    uint32_t offset = (pos + KLOG_HEADER) & (KLOG_SIZE - 1);
+    uint32_t first = len < KLOG_SIZE - offset ? len : KLOG_SIZE - offset;
+    memcpy(&ring[offset], buf, first);
+    memcpy(ring, buf + first, len - first);
+
+    __sync_synchronize();
+    *(volatile uint32_t*)header_at(pos) = len | KLOG_READY;
+}
+
+void klog_write(const char* buf, size_t len) {
+    while (len > 0) {
+        uint32_t chunk = len < KLOG_RECORD_MAX ? len : KLOG_RECORD_MAX;
+        append(buf, chunk);
+        buf += chunk;
+        len -= chunk;
+    }
+}
+
+static void console_write(const char* buf, size_t len) {
+    vga_write(buf, len);
+    vga_console_write(KLOG_CONSOLE, buf, len);
+    serial_write_buffer(SERIAL_COM1_BASE, buf, len);
+}
+
+// Write out and release ready records; returns whether there were any
+static bool consume(void) {
+    bool progress = false;
+
+    uint32_t lost = __sync_lock_test_and_set(&dropped, 0);
+    if (lost != 0) {
+        char note[48];
+        int len = ksnprintf(note, sizeof(note), "\n[klog: %u messages dropped]\n", lost);
+        console_write(note, len);
+        progress = true;
+    }
+
+    for (;;) {
+        uint32_t pos = tail;
+        if (pos == head) {
+            break;
+        }
+        uint32_t hdr = *(volatile uint32_t*)header_at(pos);
+        if (!(hdr & KLOG_READY)) {
+            break;
+        }
+
+        uint32_t len = hdr & ~KLOG_READY;
+        uint32_t offset = (pos + KLOG_HEADER) & (KLOG_SIZE - 1);
+        uint32_t first = len < KLOG_SIZE - offset ? len : KLOG_SIZE - offset;
+        console_write((const char*)&ring[offset], first);
+        if (first < len) {
+            console_write((const char*)ring, len - first);
+        }
+
+        // Clear the whole record (header included) before letting
+        // producers reuse it
+        uint32_t size = record_size(len);
+        uint32_t start = pos & (KLOG_SIZE - 1);
+        uint32_t part = size < KLOG_SIZE - start ? size : KLOG_SIZE - start;
+        memset(&ring[start], 0, part);
+        memset(ring, 0, size - part);
+
+        __sync_synchronize();
+        tail = pos + size;
+        progress = true;
+    }
+    return progress;
+}
+
+bool klog_drain(void) {
+    if (tail == head && dropped == 0) {
+        return false;
+    }
+    if (__sync_lock_test_and_set(&draining, 1)) {
+        return false;
+    }
+    bool progress = consume();
+    __sync_lock_release(&draining);
+    return progress;
+}
+
+void klog_flush(void) {
+    consume();
+}
@@ -1,25 +1,284 @@
 #include "../include/kernel.h"
+#include "../include/kernel/util.h"
+#include "../include/kernel/klog.h"
 #include "../drivers/vga.h"
-#include "../drivers/serial.h"
+
+// Everything goes through the log ring. Interrupt handlers only append
+// (they must not wait on the UART); other callers write the ring out
+// right away, which keeps their output in order with direct VGA writes.
+static void console_kick(void) {
+    if (!in_interrupt()) {
+        klog_drain();
+    }
+}
 
 // Simple kernel print function that outputs to both VGA and serial
 void kprint(const char* str) {
-    // Output to VGA
-    vga_puts(str);
-    
-    // Output to serial (COM1) for debugging
-    for (size_t i = 0; str[i] != '\0'; i++) {
-        serial_write_byte(SERIAL_COM1_BASE, str[i]);
-    }
+    klog_write(str, kstrlen(str));
+    console_kick();
 }
 
 // Print a single character
 void kputc(char c) {
-    vga_putc(c);
-    serial_write_byte(SERIAL_COM1_BASE, c);
+    klog_write(&c, 1);
+    console_kick();
 }
 
 // Clear screen
 void kclear(void) {
     vga_clear();
 }
+
+// ---------------------------------------------------------------------------
+// Formatted output
+//
+// The formatter writes into a caller-supplied buffer. ksnprintf() just
+// stops storing when it is full; kprintf() hands it to the log ring and
+// starts over, which in practice happens only for very long messages.
+// ---------------------------------------------------------------------------
+
+#define KPRINTF_BUFFER 256
+
+struct fmt_out {
+    char* buf;
+    size_t size;        // Capacity of buf
+    size_t len;         // Bytes stored in buf
+    size_t total;       // Bytes produced so far, stored or not
+    void (*flush)(const char* buf, size_t len);   // NULL: truncate instead
+};
+
+static void out_char(struct fmt_out* out, char c) {
+    if (out->len == out->size && out->flush != NULL) {
+        out->flush(out->buf, out->len);
+        out->len = 0;
+    }
+    if (out->len < out->size) {
+        out->buf[out->len++] = c;
+    }
+    out->total++;
+}
+
+static void out_repeat(struct fmt_out* out, char c, int count) {
+    while (count-- > 0) {
+        out_char(out, c);
+    }
+}
+
+static void out_chars(struct fmt_out* out, const char* s, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        out_char(out, s[i]);
+    }
+}
+
+#define FMT_LEFT 0x01   // '-': pad on the right
+#define FMT_ZERO 0x02   // '0': pad numbers with zeros
+
+// Emit prefix (sign or "0x") and digits, padded to width
+static void out_number(struct fmt_out* out, const char* prefix, const char* digits,
+                       size_t len, int flags, int width) {
+    size_t prefix_len = kstrlen(prefix);
+    int pad = width - (int)(prefix_len + len);
+
+    if (!(flags & (FMT_LEFT | FMT_ZERO))) {
+        out_repeat(out, ' ', pad);
+    }
+    out_chars(out, prefix, prefix_len);
+    if ((flags & (FMT_LEFT | FMT_ZERO)) == FMT_ZERO) {
+        out_repeat(out, '0', pad);
+    }
+    out_chars(out, digits, len);
+    if (flags & FMT_LEFT) {
+        out_repeat(out, ' ', pad);
+    }
+}
+
+// Integer argument sizes
+enum { ARG_INT, ARG_LONG, ARG_LLONG, ARG_SIZE };
+
+static void format(struct fmt_out* out, const char* fmt, va_list args) {
+    char digits[24];
+
+    while (*fmt) {
+        if (*fmt != '%') {
+            out_char(out, *fmt++);
+            continue;
+        }
+        fmt++;
+
+        int flags = 0;
+        for (;; fmt++) {
+            if (*fmt == '-') {
+                flags |= FMT_LEFT;
+            } else if (*fmt == '0') {
+                flags |= FMT_ZERO;
+            } else {
+                break;
+            }
+        }
+
+        int width = 0;
+        if (*fmt == '*') {
+            width = va_arg(args, int);
+            if (width < 0) {
+                flags |= FMT_LEFT;
+                width = -width;
+            }
+            fmt++;
+        } else {
+            while (kisdigit(*fmt)) {
+                width = width * 10 + (*fmt++ - '0');
+            }
+        }
+
+        int precision = -1;
+        if (*fmt == '.') {
+            fmt++;
+            precision = 0;
+            if (*fmt == '*') {
+                precision = va_arg(args, int);
+                fmt++;
+            } else {
+                while (kisdigit(*fmt)) {
+                    precision = precision * 10 + (*fmt++ - '0');
+                }
+            }
+        }
+
+        int size = ARG_INT;
+        if (*fmt == 'h') {
+            // Promoted to int anyway
+            while (*fmt == 'h') {
+                fmt++;
+            }
+        } else if (*fmt == 'l') {
+            fmt++;
+            size = ARG_LONG;
+            if (*fmt == 'l') {
+                fmt++;
+                size = ARG_LLONG;
+            }
+        } else if (*fmt == 'z') {
+            fmt++;
+            size = ARG_SIZE;
+        }
+
+        char conv = *fmt;
+        if (conv == '\0') {
+            break;
+        }
+        fmt++;
+
+        switch (conv) {
+        case 'd':
+        case 'i': {
+            int64_t value;
+            if (size == ARG_LLONG) {
+                value = va_arg(args, long long);
+            } else if (size == ARG_LONG) {
+                value = va_arg(args, long);
+            } else {
+                value = va_arg(args, int);
+            }
+            uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+            size_t len = kfmt_dec64(digits, magnitude);
+            out_number(out, value < 0 ? "-" : "", digits, len, flags, width);
+            break;
+        }
+        case 'u':
+        case 'x':
+        case 'X': {
+            uint64_t value;
+            if (size == ARG_LLONG) {
+                value = va_arg(args, unsigned long long);
+            } else if (size == ARG_LONG) {
+                value = va_arg(args, unsigned long);
+            } else if (size == ARG_SIZE) {
+                value = va_arg(args, size_t);
+            } else {
+                value = va_arg(args, unsigned int);
+            }
+            size_t len;
+            if (conv == 'u') {
+                len = kfmt_dec64(digits, value);
+            } else {
+                len = kfmt_hex64(digits, value, 1);
+                if (conv == 'x') {
+                    for (size_t i = 0; i < len; i++) {
+                        digits[i] = (char)ktolower(digits[i]);
+                    }
+                }
+            }
+            out_number(out, "", digits, len, flags, width);
+            break;
+        }
+        case 'p': {
+            uintptr_t value = (uintptr_t)va_arg(args, void*);
+            size_t len = kfmt_hex(digits, (uint32_t)value, 8);
+            out_number(out, "0x", digits, len, flags & FMT_LEFT, width);
+            break;
+        }
+        case 's': {
+            const char* s = va_arg(args, const char*);
+            if (s == NULL) {
+                s = "(null)";
+            }
+            size_t len = 0;
+            while (s[len] && (precision < 0 || len < (size_t)precision)) {
+                len++;
+            }
+            out_number(out, "", s, len, flags & FMT_LEFT, width);
+            break;
+        }
+        case 'c':
+            digits[0] = (char)va_arg(args, int);
+            out_number(out, "", digits, 1, flags & FMT_LEFT, width);
+            break;
+        case '%':
+            out_char(out, '%');
+            break;
+        default:
+            // Unknown conversion: show it as written
+            out_char(out, '%');
+            out_char(out, conv);
+            break;
+        }
+    }
+}
+
+int kvsnprintf(char* buf, size_t size, const char* fmt, va_list args) {
+    struct fmt_out out = { buf, size > 0 ? size - 1 : 0, 0, 0, NULL };
+
+    format(&out, fmt, args);
+    if (size > 0) {
+        buf[out.len] = '\0';
+    }
+    return (int)out.total;
+}
+
+int ksnprintf(char* buf, size_t size, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int ret = kvsnprintf(buf, size, fmt, args);
+    va_end(args);
+    return ret;
+}
+
+int kvprintf(const char* fmt, va_list args) {
+    char buf[KPRINTF_BUFFER];
+    struct fmt_out out = { buf, sizeof(buf), 0, 0, klog_write };
+
+    format(&out, fmt, args);
+    if (out.len > 0) {
+        klog_write(buf, out.len);
+    }
+    console_kick();
+    return (int)out.total;
+}
+
+int kprintf(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int ret = kvprintf(fmt, args);
+    va_end(args);
+    return ret;
+}
@@ -5,6 +5,8 @@
 #include "../drivers/keyboard.h"
 #include "../drivers/timer.h"
 #include "interrupts.h"
+#include "kernel/mm.h"
+#include "kernel/klog.h"
 
 // Kernel entry point - called by bootloader
 __attribute__((section(".multiboot")))
@@ -35,9 +37,9 @@ void _start(void) {
     // Call the main kernel function from kernel.c
     _kernel_main();
 
-    // If kernel_main returns, halt the system
+    // If kernel_main returns, idle forever
     for (;;) {
-        __asm__ volatile ("hlt");
+        idle();
     }
 }
 
@@ -46,4 +48,18 @@ void halt(void) {
     __asm__ volatile ("hlt");
 }
 
+// One turn of an idle loop: do a slice of background work if there is
+// any, otherwise sleep until the next interrupt
+void idle(void) {
+    // Console output logged by interrupt handlers, and scrollback
+    // moves requested from the keyboard
+    if (klog_drain() || vga_poll()) {
+        return;
+    }
+    if (pfa_zero_idle()) {
+        return;
+    }
+    __asm__ volatile ("hlt");
+}
+
 // cli() and sti() are defined in interrupts.h
@@ -5,88 +5,916 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
-// Simple memory block structure
+// Simple memory block structure. prev_size is a boundary tag holding the
+// payload size of the block just below this one, so both neighbours of a
+// block can be reached without walking the list.
 struct block {
     size_t size;
+    size_t prev_size;
     bool free;
     struct block *next;
 };
 
-// Start of the heap
-static uint8_t heap[KERNEL_HEAP_SIZE];
-static struct block *free_list = (void*)heap;
+#define BLOCK_HDR sizeof(struct block)
+
+// Slab header, stored at the start of every page owned by a size class.
+// A slab is an ordinary heap block whose payload is page aligned and spans
+// PAGE_SIZE - BLOCK_HDR bytes, so the header of the block that follows it
+// fits in the last few bytes of the page.
+struct slab {
+    struct slab *next;      // Next slab in the class partial list
+    struct slab *prev;      // Previous slab in the class partial list
+    void *free;             // Free objects in this slab (singly linked)
+    uint16_t inuse;         // Objects handed out
+    uint16_t total;         // Objects carved from this slab
+    uint8_t cls;            // Owning size class
+};
+
+#define SLAB_HDR   ((sizeof(struct slab) + 15) & ~(size_t)15)
+#define SLAB_BYTES (PAGE_SIZE - BLOCK_HDR)
+
+// Per-class state: slabs with at least one free object, plus counters
+struct size_class {
+    size_t size;
+    struct slab *partial;
+    size_t slabs;
+    size_t hits;
+    size_t misses;
+};
+
+// The heap is a page-aligned virtual window; only [heap, heap_end) is mapped
+static uint8_t * const heap = (uint8_t*)KERNEL_HEAP_START;
+static uint8_t *heap_end;
+static struct block *free_list;
+static struct block *last_block;
+
+// Everything in [heap_zero, heap_end) is known to be zero: the heap maps
+// only zero-filled frames, and the mark only moves up as the heap is used
+static uint8_t *heap_zero;
+
+// Grow by at least this much to amortize mapping work
+#define HEAP_GROW_MIN   (4 * PAGE_SIZE)
+// Only give pages back once this much is free at the top of the heap
+#define HEAP_TRIM_MIN   (16 * PAGE_SIZE)
+// Every this many trim checks, the remembered peak decays halfway to the
+// current top of the heap
+#define HEAP_TRIM_EPOCH 1024
+
+// Recent peak of the mapped heap. Trimming never drops below it, so a heap
+// that shrinks and regrows every few calls keeps its pages mapped; the peak
+// decays so pages still go back once use stays low.
+static uint8_t *heap_peak;
+static size_t heap_trim_checks;
+
+// Owning size class + 1 for every heap page that is a slab, 0 otherwise
+static uint8_t page_class[KERNEL_HEAP_MAX / PAGE_SIZE];
+
+static struct size_class classes[MM_SIZE_CLASSES] = {
+    { .size = 16 }, { .size = 32 }, { .size = 64 },
+    { .size = 128 }, { .size = 256 }, { .size = 512 },
+};
+
+static size_t alloc_count;
+static size_t free_count;
+
+// Bytes handed out (slab objects count their full class size, heap blocks
+// their block size; IRQ reserve objects count as handed out) and the most
+// that has ever been out at once
+static size_t bytes_in_use;
+static size_t peak_in_use;
+
+// kmalloc request sizes: bucket i counts sizes up to 16 << i, the last
+// bucket everything larger
+static size_t size_hist[MM_HIST_BUCKETS];
+static size_t realloc_inplace;
+static size_t realloc_moved;
+
+// Longest run of blocks a single first-fit search had to step over
+static size_t walk_max;
+
+// Interrupt context never touches the block list or the slabs. kmalloc
+// pops objects from small per-class reserve stacks and kfree pushes onto a
+// deferred list; both are lock-free (cmpxchg), so neither side needs cli.
+// Mainline code refills the reserves and drains the deferred list on its
+// next kmalloc/kfree.
+#define IRQ_RESERVE     8   // Objects kept per class
+#define IRQ_RESERVE_LOW 4   // Ask for a refill below this
+
+struct irq_object {
+    struct irq_object *next;
+};
+
+struct irq_reserve {
+    struct irq_object * volatile head;
+    volatile uint32_t count;
+};
+
+static struct irq_reserve irq_reserve[MM_SIZE_CLASSES];
+static struct irq_object * volatile irq_deferred;
+static volatile bool irq_low;
+static volatile size_t irq_alloc_count;
+static volatile size_t irq_alloc_failed;
+// Interrupt-context allocations per class not yet in alloc_count/size_hist
+static volatile size_t irq_unaccounted[MM_SIZE_CLASSES];
 
 // Initialize the memory manager
 void mm_init(uintptr_t mem_upper) {
-    (void)mem_upper; // Currently unused, but kept for future use
-    free_list->size = KERNEL_HEAP_SIZE - sizeof(struct block);
-    free_list->free = true;
-    free_list->next = NULL;
+    for (int i = 0; i < MM_SIZE_CLASSES; i++) {
+        classes[i].partial = NULL;
+        classes[i].slabs = 0;
+        classes[i].hits = 0;
+        classes[i].misses = 0;
+    }
+    alloc_count = 0;
+    free_count = 0;
+    bytes_in_use = 0;
+    peak_in_use = 0;
+    memset(size_hist, 0, sizeof(size_hist));
+    realloc_inplace = 0;
+    realloc_moved = 0;
+    walk_max = 0;
+    for (int i = 0; i < MM_SIZE_CLASSES; i++) {
+        irq_reserve[i].head = NULL;
+        irq_reserve[i].count = 0;
+    }
+    irq_deferred = NULL;
+    irq_alloc_count = 0;
+    irq_alloc_failed = 0;
+    for (int i = 0; i < MM_SIZE_CLASSES; i++) {
+        irq_unaccounted[i] = 0;
+    }
+
+    // Without a memory map, everything between 1MB and mem_upper is usable
+    if (!mm_have_memory_map() && mem_upper != 0) {
+        mm_add_region(0x100000, (size_t)mem_upper * 1024, MEMORY_FREE);
+    }
+    pfa_init();
+    vmm_init();
+    heap_init();
+
+    // Fill the interrupt reserves before any handler can allocate
+    irq_low = true;
 }
 
-// Simple implementation of kmalloc (first-fit algorithm)
-void* kmalloc(size_t size) {
+// Map a request size to its size class (16, 32, ... MM_SMALL_MAX)
+static inline int size_to_class(size_t size) {
+    if (size <= 16) {
+        return 0;
+    }
+    return (int)(sizeof(unsigned int) * 8) - __builtin_clz((unsigned int)(size - 1)) - 4;
+}
+
+// Histogram bucket of a request size
+static inline int size_to_bucket(size_t size) {
+    if (size > (size_t)16 << (MM_HIST_BUCKETS - 2)) {
+        return MM_HIST_BUCKETS - 1;
+    }
+    return size_to_class(size);
+}
+
+// Account for bytes leaving or returning to the allocator
+static inline void stat_take(size_t bytes) {
+    bytes_in_use += bytes;
+    if (bytes_in_use > peak_in_use) {
+        peak_in_use = bytes_in_use;
+    }
+}
+
+static inline void stat_give(size_t bytes) {
+    bytes_in_use -= bytes;
+}
+
+// Physically preceding block, found through the boundary tag
+static inline struct block* block_prev(struct block *b) {
+    if (b == free_list) {
+        return NULL;
+    }
+    return (struct block*)((uint8_t*)b - b->prev_size - BLOCK_HDR);
+}
+
+// Refresh the boundary tag of the block following b after b changed size
+static inline void block_sync_next(struct block *b) {
+    if (b->next != NULL) {
+        b->next->prev_size = b->size;
+    }
+}
+
+// Record that heap memory below end has been written
+static inline void heap_touch(void *end) {
+    if ((uint8_t*)end > heap_zero) {
+        heap_zero = end;
+    }
+}
+
+// Split curr so that it holds exactly size bytes, if the remainder is usable
+static void block_split(struct block *curr, size_t size) {
+    if ((curr->size - size) > (BLOCK_HDR + 8)) {
+        struct block *new_block = (void*)((uint8_t*)curr + BLOCK_HDR + size);
+        heap_touch((uint8_t*)new_block + BLOCK_HDR);
+        new_block->size = curr->size - size - BLOCK_HDR;
+        new_block->prev_size = size;
+        new_block->free = true;
+        new_block->next = curr->next;
+        block_sync_next(new_block);
+
+        curr->size = size;
+        curr->next = new_block;
+        if (last_block == curr) {
+            last_block = new_block;
+        }
+    }
+}
+
+// Remember the longest first-fit search seen so far
+static inline void walk_record(size_t steps) {
+    if (steps > walk_max) {
+        walk_max = steps;
+    }
+}
+
+// First-fit allocation from the block list
+static void* block_alloc(size_t size) {
     struct block *curr;
-    void *result = NULL;
-    
-    // Align size to 8 bytes
-    size = (size + 7) & ~7;
-    
-    // Find a free block that's large enough
-    for (curr = free_list; curr != NULL; curr = curr->next) {
+    size_t steps = 0;
+
+    for (curr = free_list; curr != NULL; curr = curr->next, steps++) {
         if (curr->free && curr->size >= size) {
-            // If the block is big enough to split
-            if ((curr->size - size) > (sizeof(struct block) + 8)) {
-                struct block *new_block = (void*)((uint8_t*)curr + sizeof(struct block) + size);
-                new_block->size = curr->size - size - sizeof(struct block);
-                new_block->free = true;
-                new_block->next = curr->next;
-                
-                curr->size = size;
-                curr->next = new_block;
-            }
-            
+            walk_record(steps);
+            block_split(curr, size);
             curr->free = false;
-            result = (void*)((uint8_t*)curr + sizeof(struct block));
-            break;
+            heap_touch((uint8_t*)curr + BLOCK_HDR + curr->size);
+            return (void*)((uint8_t*)curr + BLOCK_HDR);
         }
     }
-    
-    return result;
+
+    walk_record(steps);
+    return NULL;
 }
 
-// Simple implementation of kfree
-void kfree(void *ptr) {
-    if (ptr == NULL) {
-        return;
+// First-fit allocation of a block whose payload starts on an align boundary.
+// Any space in front of the aligned payload is kept as a free block.
+static void* block_alloc_aligned(size_t size, size_t align) {
+    struct block *curr;
+    size_t steps = 0;
+
+    for (curr = free_list; curr != NULL; curr = curr->next, steps++) {
+        if (!curr->free) {
+            continue;
+        }
+
+        uintptr_t payload = (uintptr_t)curr + BLOCK_HDR;
+        uintptr_t aligned = (payload + align - 1) & ~(uintptr_t)(align - 1);
+        size_t lead = aligned - payload;
+
+        // The leading gap must be able to hold a block of its own
+        if (lead != 0 && lead < BLOCK_HDR + 8) {
+            aligned += align;
+            lead += align;
+        }
+        if (curr->size < lead + size) {
+            continue;
+        }
+
+        if (lead != 0) {
+            struct block *new_block = (void*)(aligned - BLOCK_HDR);
+            heap_touch((void*)aligned);
+            new_block->size = curr->size - lead;
+            new_block->prev_size = lead - BLOCK_HDR;
+            new_block->free = true;
+            new_block->next = curr->next;
+            block_sync_next(new_block);
+
+            curr->size = lead - BLOCK_HDR;
+            curr->next = new_block;
+            if (last_block == curr) {
+                last_block = new_block;
+            }
+            curr = new_block;
+        }
+
+        walk_record(steps);
+        block_split(curr, size);
+        curr->free = false;
+        heap_touch((uint8_t*)aligned + curr->size);
+        return (void*)aligned;
     }
-    
-    struct block *curr = (struct block*)((uint8_t*)ptr - sizeof(struct block));
+
+    walk_record(steps);
+    return NULL;
+}
+
+// Return a block to the list, merging with free neighbours in O(1).
+// Returns the block that now holds the freed space.
+static struct block* block_free(struct block *curr) {
     curr->free = true;
-    
+
     // Merge with next block if it's free
     if (curr->next != NULL && curr->next->free) {
-        curr->size += curr->next->size + sizeof(struct block);
+        if (last_block == curr->next) {
+            last_block = curr;
+        }
+        curr->size += curr->next->size + BLOCK_HDR;
         curr->next = curr->next->next;
     }
-    
+
     // Merge with previous block if it's free
-    if (curr != free_list) {
-        struct block *prev = free_list;
-        while (prev->next != curr) {
-            prev = prev->next;
+    struct block *prev = block_prev(curr);
+    if (prev != NULL && prev->free) {
+        if (last_block == curr) {
+            last_block = prev;
+        }
+        prev->size += curr->size + BLOCK_HDR;
+        prev->next = curr->next;
+        curr = prev;
+    }
+
+    block_sync_next(curr);
+    return curr;
+}
+
+// Map the initial heap window
+void heap_init(void) {
+    heap_end = heap;
+    heap_peak = heap;
+    heap_trim_checks = 0;
+    free_list = NULL;
+    last_block = NULL;
+    memset(page_class, 0, sizeof(page_class));
+
+    for (size_t off = 0; off < KERNEL_HEAP_INITIAL; off += PAGE_SIZE) {
+        void *frame = pfa_alloc_zeroed();
+        if (frame == NULL || vmm_map_page(frame, heap_end) == NULL) {
+            pfa_free(frame);
+            break;
+        }
+        heap_end += PAGE_SIZE;
+    }
+    if (heap_end == heap) {
+        return;
+    }
+
+    heap_zero = heap + BLOCK_HDR;
+    free_list = last_block = (struct block*)heap;
+    free_list->size = (size_t)(heap_end - heap) - BLOCK_HDR;
+    free_list->prev_size = 0;
+    free_list->free = true;
+    free_list->next = NULL;
+}
+
+// Map fresh pages at the top of the heap so that a free block of at least
+// size bytes exists at the end of the block list (sbrk-style)
+static bool heap_grow(size_t size) {
+    if (free_list == NULL) {
+        return false;
+    }
+
+    size_t need = size + BLOCK_HDR;
+    if (last_block->free) {
+        need = size > last_block->size ? size - last_block->size : 0;
+    }
+    if (need < HEAP_GROW_MIN) {
+        need = HEAP_GROW_MIN;
+    }
+    need = (need + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+
+    uint8_t *old_end = heap_end;
+    while ((size_t)(heap_end - old_end) < need && heap_end < heap + KERNEL_HEAP_MAX) {
+        void *frame = pfa_alloc_zeroed();
+        if (frame == NULL || vmm_map_page(frame, heap_end) == NULL) {
+            pfa_free(frame);
+            break;
+        }
+        heap_end += PAGE_SIZE;
+    }
+
+    size_t grown = (size_t)(heap_end - old_end);
+    if (grown == 0) {
+        return false;
+    }
+    if (heap_end > heap_peak) {
+        heap_peak = heap_end;
+    }
+
+    if (last_block->free) {
+        last_block->size += grown;
+    } else {
+        struct block *b = (struct block*)old_end;
+        heap_touch(old_end + BLOCK_HDR);
+        b->size = grown - BLOCK_HDR;
+        b->prev_size = last_block->size;
+        b->free = true;
+        b->next = NULL;
+        last_block->next = b;
+        last_block = b;
+    }
+    return last_block->size >= size;
+}
+
+// Unmap whole free pages at the top of the heap once enough have piled up
+// above both the last block and the recent peak
+static void heap_trim(void) {
+    if (last_block == NULL || !last_block->free) {
+        return;
+    }
+
+    // Keep the last block's header plus a little payload mapped
+    uintptr_t keep = ((uintptr_t)last_block + BLOCK_HDR + 16 + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1);
+    if (keep < (uintptr_t)heap + KERNEL_HEAP_INITIAL) {
+        keep = (uintptr_t)heap + KERNEL_HEAP_INITIAL;
+    }
+
+    if (++heap_trim_checks >= HEAP_TRIM_EPOCH) {
+        heap_trim_checks = 0;
+        if ((uintptr_t)heap_peak > keep) {
+            uintptr_t decayed = keep + ((uintptr_t)heap_peak - keep) / 2;
+            heap_peak = (uint8_t*)((decayed + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1));
+        }
+    }
+    if (keep < (uintptr_t)heap_peak) {
+        keep = (uintptr_t)heap_peak;
+    }
+    if ((uintptr_t)heap_end <= keep || (uintptr_t)heap_end - keep < HEAP_TRIM_MIN) {
+        return;
+    }
+
+    while ((uintptr_t)heap_end > keep) {
+        heap_end -= PAGE_SIZE;
+        uintptr_t frame = vmm_get_physical(heap_end);
+        vmm_unmap_page(heap_end);
+        pfa_free((void*)frame);
+    }
+    last_block->size = (size_t)(heap_end - (uint8_t*)last_block) - BLOCK_HDR;
+    if (heap_zero > heap_end) {
+        heap_zero = heap_end;
+    }
+}
+
+// Large allocations: first fit, growing the heap when nothing fits
+void* heap_alloc(size_t size) {
+    // Align size to 8 bytes
+    size = (size + 7) & ~(size_t)7;
+
+    void *result = block_alloc(size);
+    if (result == NULL && heap_grow(size)) {
+        result = block_alloc(size);
+    }
+    return result;
+}
+
+void heap_free(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    block_free((struct block*)((uint8_t*)ptr - BLOCK_HDR));
+    heap_trim();
+}
+
+// Unlink a slab from its class partial list
+static void slab_unlink(struct size_class *sc, struct slab *s) {
+    if (s->prev) {
+        s->prev->next = s->next;
+    } else {
+        sc->partial = s->next;
+    }
+    if (s->next) {
+        s->next->prev = s->prev;
+    }
+    s->next = s->prev = NULL;
+}
+
+// Push a slab onto the front of its class partial list
+static void slab_link(struct size_class *sc, struct slab *s) {
+    s->prev = NULL;
+    s->next = sc->partial;
+    if (sc->partial) {
+        sc->partial->prev = s;
+    }
+    sc->partial = s;
+}
+
+// Carve a fresh page out of the heap for size class cls
+static struct slab* slab_create(int cls) {
+    struct size_class *sc = &classes[cls];
+    struct slab *s = block_alloc_aligned(SLAB_BYTES, PAGE_SIZE);
+    if (s == NULL && heap_grow(SLAB_BYTES + PAGE_SIZE + BLOCK_HDR)) {
+        s = block_alloc_aligned(SLAB_BYTES, PAGE_SIZE);
+    }
+    if (s == NULL) {
+        return NULL;
+    }
+
+    s->next = s->prev = NULL;
+    s->free = NULL;
+    s->inuse = 0;
+    s->total = (uint16_t)((SLAB_BYTES - SLAB_HDR) / sc->size);
+    s->cls = (uint8_t)cls;
+
+    // Thread every object onto the slab free list, lowest address first
+    uint8_t *obj = (uint8_t*)s + SLAB_HDR + (size_t)(s->total - 1) * sc->size;
+    for (uint16_t i = 0; i < s->total; i++, obj -= sc->size) {
+        *(void**)obj = s->free;
+        s->free = obj;
+    }
+
+    page_class[((uint8_t*)s - heap) / PAGE_SIZE] = (uint8_t)(cls + 1);
+    sc->slabs++;
+    slab_link(sc, s);
+    return s;
+}
+
+// O(1) small allocation from a size class
+static void* slab_alloc(int cls) {
+    struct size_class *sc = &classes[cls];
+    struct slab *s = sc->partial;
+
+    if (s != NULL) {
+        sc->hits++;
+    } else {
+        sc->misses++;
+        s = slab_create(cls);
+        if (s == NULL) {
+            return NULL;
         }
-        
-        if (prev->free) {
-            prev->size += curr->size + sizeof(struct block);
-            prev->next = curr->next;
+    }
+
+    void *obj = s->free;
+    s->free = *(void**)obj;
+    s->inuse++;
+
+    // Full slabs leave the partial list until an object comes back
+    if (s->free == NULL) {
+        slab_unlink(sc, s);
+    }
+    return obj;
+}
+
+// O(1) small free; empty slabs go back to the heap unless they are the
+// class's only partial slab
+static void slab_free(struct slab *s, void *obj) {
+    struct size_class *sc = &classes[s->cls];
+    bool was_full = (s->free == NULL);
+
+    *(void**)obj = s->free;
+    s->free = obj;
+    s->inuse--;
+
+    if (was_full) {
+        slab_link(sc, s);
+    }
+
+    if (s->inuse == 0 && (sc->partial != s || s->next != NULL)) {
+        slab_unlink(sc, s);
+        page_class[((uint8_t*)s - heap) / PAGE_SIZE] = 0;
+        sc->slabs--;
+        heap_free(s);
+    }
+}
+
+// Push obj onto a lock-free stack; safe against an IRQ popping or pushing
+// in between the load and the exchange
+static inline void irq_push(struct irq_object * volatile *head, struct irq_object *obj) {
+    do {
+        obj->next = *head;
+    } while (!__sync_bool_compare_and_swap(head, obj->next, obj));
+}
+
+// kmalloc in interrupt context: small objects from the class reserve only.
+// Only mainline code ever pushes onto a reserve, and it cannot run while a
+// handler is in here, so the popped head cannot come back (no ABA).
+static void* irq_alloc(size_t size) {
+    if (size > MM_SMALL_MAX) {
+        irq_alloc_failed++;
+        return NULL;
+    }
+
+    int cls = size_to_class(size);
+    struct irq_reserve *r = &irq_reserve[cls];
+    struct irq_object *obj;
+    do {
+        obj = r->head;
+        if (obj == NULL) {
+            irq_low = true;
+            irq_alloc_failed++;
+            return NULL;
         }
+    } while (!__sync_bool_compare_and_swap(&r->head, obj, obj->next));
+
+    if (__sync_sub_and_fetch(&r->count, 1) < IRQ_RESERVE_LOW) {
+        irq_low = true;
+    }
+    irq_alloc_count++;
+    __sync_add_and_fetch(&irq_unaccounted[cls], 1);
+    return obj;
+}
+
+// Fold allocations made by interrupt handlers into the mainline counters.
+// Requests up to MM_SMALL_MAX land in the histogram bucket of their class.
+static void irq_account(void) {
+    for (int cls = 0; cls < MM_SIZE_CLASSES; cls++) {
+        size_t n = __sync_lock_test_and_set(&irq_unaccounted[cls], 0);
+        alloc_count += n;
+        size_hist[cls] += n;
+    }
+}
+
+static void kfree_local(void *ptr);
+
+// Top up the reserves and release whatever interrupt handlers freed
+static void irq_service(void) {
+    // Clear first: a handler that runs short meanwhile sets it again
+    irq_low = false;
+    irq_account();
+    for (int cls = 0; cls < MM_SIZE_CLASSES; cls++) {
+        struct irq_reserve *r = &irq_reserve[cls];
+        while (r->count < IRQ_RESERVE) {
+            struct irq_object *obj = slab_alloc(cls);
+            if (obj == NULL) {
+                break;
+            }
+            stat_take(classes[cls].size);
+            irq_push(&r->head, obj);
+            __sync_add_and_fetch(&r->count, 1);
+        }
+    }
+
+    struct irq_object *obj = __sync_lock_test_and_set(&irq_deferred, NULL);
+    while (obj != NULL) {
+        struct irq_object *next = obj->next;
+        kfree_local(obj);
+        obj = next;
     }
 }
 
+// Something for irq_service() to do?
+static inline bool irq_pending(void) {
+    return irq_low || irq_deferred != NULL;
+}
+
+// Allocate from mainline context: small requests come from size classes,
+// large ones from the first-fit block list
+static void* kmalloc_local(size_t size) {
+    void *result;
+    size_t got;
+
+    if (size <= MM_SMALL_MAX) {
+        int cls = size_to_class(size);
+        result = slab_alloc(cls);
+        got = classes[cls].size;
+    } else {
+        result = heap_alloc(size);
+        got = result ? ((struct block*)((uint8_t*)result - BLOCK_HDR))->size : 0;
+    }
+
+    if (result != NULL) {
+        alloc_count++;
+        size_hist[size_to_bucket(size)]++;
+        stat_take(got);
+    }
+    return result;
+}
+
+// Allocate memory; interrupt handlers get small objects only
+void* kmalloc(size_t size) {
+    if (in_interrupt()) {
+        return irq_alloc(size);
+    }
+    if (irq_pending()) {
+        irq_service();
+    }
+    return kmalloc_local(size);
+}
+
+// Free memory from mainline context
+static void kfree_local(void *ptr) {
+    free_count++;
+
+    uint8_t cls = page_class[((uint8_t*)ptr - heap) / PAGE_SIZE];
+    if (cls != 0) {
+        stat_give(classes[cls - 1].size);
+        slab_free((struct slab*)((uintptr_t)ptr & ~(uintptr_t)(PAGE_SIZE - 1)), ptr);
+        return;
+    }
+
+    stat_give(((struct block*)((uint8_t*)ptr - BLOCK_HDR))->size);
+    heap_free(ptr);
+}
+
+// Free memory returned by kmalloc. Interrupt handlers only queue the
+// pointer; the memory is released on the next mainline heap call.
+void kfree(void *ptr) {
+    if (ptr == NULL || (uint8_t*)ptr < heap || (uint8_t*)ptr >= heap_end) {
+        return;
+    }
+
+    if (in_interrupt()) {
+        irq_push(&irq_deferred, ptr);
+        return;
+    }
+    if (irq_pending()) {
+        irq_service();
+    }
+    kfree_local(ptr);
+}
+
+// Try to resize a heap block without moving it: shrink by splitting off the
+// tail, grow by absorbing a free successor (mapping more pages first when
+// the block sits at the top of the heap)
+static bool block_resize(struct block *b, size_t size) {
+    if (size > b->size) {
+        struct block *next = b->next;
+        bool at_top = (b == last_block) || (next == last_block && next->free);
+
+        if (at_top && (next == NULL || b->size + BLOCK_HDR + next->size < size)) {
+            size_t have = (next != NULL) ? next->size : 0;
+            size_t want = size - b->size;
+            if (!heap_grow(want > have ? want : have)) {
+                return false;
+            }
+            next = b->next;
+        }
+        if (next == NULL || !next->free || b->size + BLOCK_HDR + next->size < size) {
+            return false;
+        }
+
+        if (last_block == next) {
+            last_block = b;
+        }
+        b->size += BLOCK_HDR + next->size;
+        b->next = next->next;
+        block_sync_next(b);
+    }
+
+    // Give back the tail, merging it with whatever follows
+    size_t old = b->size;
+    block_split(b, size);
+    if (b->size != old) {
+        block_free(b->next);
+        heap_trim();
+    }
+    heap_touch((uint8_t*)b + BLOCK_HDR + b->size);
+    return true;
+}
+
+// Resize an allocation, in place whenever possible. Interrupt handlers can
+// only use it as kmalloc.
+void* krealloc(void* ptr, size_t size) {
+    size_t old_size;
+
+    if (ptr == NULL) {
+        return kmalloc(size);
+    }
+    if (in_interrupt()) {
+        return NULL;
+    }
+    if (size == 0) {
+        kfree(ptr);
+        return NULL;
+    }
+    if ((uint8_t*)ptr < heap || (uint8_t*)ptr >= heap_end) {
+        return NULL;
+    }
+
+    uint8_t cls = page_class[((uint8_t*)ptr - heap) / PAGE_SIZE];
+    if (cls != 0) {
+        // Anything that still fits the object's class stays put
+        old_size = classes[cls - 1].size;
+        if (size <= old_size) {
+            realloc_inplace++;
+            return ptr;
+        }
+    } else {
+        struct block *b = (struct block*)((uint8_t*)ptr - BLOCK_HDR);
+        size_t aligned = (size + 7) & ~(size_t)7;
+        size_t before = b->size;
+        if (block_resize(b, aligned)) {
+            stat_give(before);
+            stat_take(b->size);
+            realloc_inplace++;
+            return ptr;
+        }
+        old_size = b->size;
+    }
+
+    void *result = kmalloc(size);
+    if (result == NULL) {
+        return NULL;
+    }
+    memcpy(result, ptr, old_size < size ? old_size : size);
+    kfree(ptr);
+    realloc_moved++;
+    return result;
+}
+
+// Allocate zeroed memory; memory above the heap's zero mark is skipped
+void* kcalloc(size_t num, size_t size) {
+    if (size != 0 && num > SIZE_MAX / size) {
+        return NULL;
+    }
+    size *= num;
+
+    if (in_interrupt()) {
+        void *obj = irq_alloc(size);
+        if (obj != NULL) {
+            memset(obj, 0, size);
+        }
+        return obj;
+    }
+    if (irq_pending()) {
+        irq_service();
+    }
+
+    // The zero mark is only trustworthy until the heap is touched again
+    uint8_t *zero = heap_zero;
+    uint8_t *p = kmalloc_local(size);
+    if (p == NULL) {
+        return NULL;
+    }
+
+    // Slab objects carry free-list links, so they're always cleared
+    if (size <= MM_SMALL_MAX || p + size <= zero) {
+        memset(p, 0, size);
+    } else if (p < zero) {
+        memset(p, 0, (size_t)(zero - p));
+    }
+    return p;
+}
+
+// Collect heap usage and per-class counters
+void mm_get_stats(memory_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+    if (!in_interrupt()) {
+        irq_account();
+    }
+
+    stats->total_memory = (size_t)(heap_end - heap);
+    stats->used_memory = 0;
+    stats->free_memory = 0;
+    stats->block_count = 0;
+    stats->largest_free = 0;
+
+    for (struct block *curr = free_list; curr != NULL; curr = curr->next) {
+        if (curr->free) {
+            stats->free_memory += curr->size;
+            if (curr->size > stats->largest_free) {
+                stats->largest_free = curr->size;
+            }
+        } else {
+            stats->used_memory += curr->size;
+        }
+        stats->block_count++;
+    }
+
+    stats->phys_total = pfa_total_frames() * PAGE_SIZE;
+    stats->phys_free = pfa_free_frames() * PAGE_SIZE;
+    stats->alloc_count = alloc_count;
+    stats->free_count = free_count;
+    stats->bytes_in_use = bytes_in_use;
+    stats->peak_in_use = peak_in_use;
+    for (int i = 0; i < MM_HIST_BUCKETS; i++) {
+        stats->size_hist[i] = size_hist[i];
+    }
+    stats->realloc_inplace = realloc_inplace;
+    stats->realloc_moved = realloc_moved;
+    stats->max_walk = walk_max;
+    pfa_zero_stats(&stats->zero_pool, &stats->zero_hits, &stats->zero_misses);
+    stats->irq_alloc_count = irq_alloc_count;
+    stats->irq_alloc_failed = irq_alloc_failed;
+
+    for (int i = 0; i < MM_SIZE_CLASSES; i++) {
+        stats->class_size[i] = classes[i].size;
+        stats->class_hits[i] = classes[i].hits;
+        stats->class_misses[i] = classes[i].misses;
+        stats->class_slabs[i] = classes[i].slabs;
+    }
+}
+
+// Extended memory size in KB from the CMOS (used when nothing better is known)
+static uintptr_t cmos_mem_upper(void) {
+    uint32_t kb;
+
+    // 64KB blocks above 16MB
+    outb(0x70, 0x34);
+    kb = inb(0x71);
+    outb(0x70, 0x35);
+    kb |= (uint32_t)inb(0x71) << 8;
+    if (kb != 0) {
+        return (uintptr_t)kb * 64 + 15 * 1024;
+    }
+
+    // KB between 1MB and 16MB
+    outb(0x70, 0x30);
+    kb = inb(0x71);
+    outb(0x70, 0x31);
+    kb |= (uint32_t)inb(0x71) << 8;
+    return kb;
+}
+
 // Initialize memory manager during kernel startup
 void mm_initialize(void) {
-    mm_init(0); // We're not using the memory map yet
+    mm_init(mm_have_memory_map() ? 0 : cmos_mem_upper());
     vga_puts("Memory manager initialized\n");
 }
@@ -1,12 +1,20 @@
 #include "../include/kernel.h"
 #include "../drivers/vga.h"
 #include "../drivers/serial.h"
+#include "../include/kernel/klog.h"
 
 // Kernel panic function - displays error message and halts the system
 void panic(const char* message) {
     // Disable interrupts
     cli();
+
+    // Get out whatever was logged before (the screen is about to be
+    // cleared, but serial keeps it)
+    klog_flush();
     
+    // Make sure the kernel console is the one on screen
+    vga_console_switch(0);
+
     // Set error color (white on red)
     vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
     vga_clear();
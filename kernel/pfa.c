@@ -0,0 +1,421 @@
+#include "../include/kernel.h"
+#include "../include/kernel/mm.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Binary buddy page frame allocator.
+//
+// Every usable frame below MM_PHYS_LIMIT is tracked. Free blocks of 2^k
+// frames sit on a doubly linked per-order free list (linked through the
+// frame table) and have their bit set in that order's bitmap, so finding
+// and unlinking a buddy on free is O(1) and a whole alloc/free is
+// O(PFA_MAX_ORDER).
+
+#define PFA_NONE        0xFFFFFFFFu
+#define PFA_MAX_REGIONS 32
+
+// Per-frame metadata
+struct frame {
+    uint32_t next;      // Next free block of the same order
+    uint32_t prev;      // Previous free block of the same order
+    uint16_t refcount;  // Users of an allocated frame
+    uint8_t order;      // Order of the block this frame heads
+    uint8_t flags;
+};
+
+#define FRAME_FREE  0x01    // Heads a block on a free list
+#define FRAME_ALLOC 0x02    // Heads an allocated block
+
+// End of the kernel image (linker.ld)
+extern uint8_t _kernel_end[];
+
+// Boot memory map, filled through mm_add_region()/mm_remove_region()
+static memory_map_entry_t regions[PFA_MAX_REGIONS];
+static size_t region_count;
+
+static struct frame *frames;
+static uint32_t *free_bitmap[PFA_MAX_ORDER + 1];
+static uint32_t free_head[PFA_MAX_ORDER + 1];
+static uint32_t max_pfn;
+static size_t total_frames;
+static size_t free_frames;
+
+// Frames zeroed ahead of time by the idle loop. They are allocated as far
+// as the buddy lists are concerned and go back to normal use only when the
+// buddy lists run dry.
+#define ZERO_POOL_SIZE 32
+
+static void *zero_pool[ZERO_POOL_SIZE];
+static size_t zero_count;
+static size_t zero_hits;
+static size_t zero_misses;
+
+// Record a region of the physical memory map
+void mm_add_region(uintptr_t base, size_t size, uint32_t type) {
+    if (region_count >= PFA_MAX_REGIONS || size == 0) {
+        return;
+    }
+    regions[region_count].base = base;
+    regions[region_count].length = size;
+    regions[region_count].type = type;
+    regions[region_count].acpi_attrs = 0;
+    region_count++;
+}
+
+// Exclude a range from the allocator (reserved entries override free ones)
+void mm_remove_region(uintptr_t base, size_t size) {
+    mm_add_region(base, size, MEMORY_RESERVED);
+}
+
+// Has a memory map been registered?
+bool mm_have_memory_map(void) {
+    return region_count != 0;
+}
+
+// Print the recorded memory map and how many frames are free
+void mm_print_map(void) {
+    static const char *type_names[] = { "?", "free", "reserved", "ACPI reclaim", "ACPI NVS", "bad" };
+
+    kprintf("Physical memory map:\n");
+    for (size_t i = 0; i < region_count; i++) {
+        uint32_t type = regions[i].type;
+        kprintf("  %08X-%08X  %s\n", (uint32_t)regions[i].base,
+                (uint32_t)(regions[i].base + regions[i].length - 1),
+                type <= MEMORY_BADRAM ? type_names[type] : type_names[0]);
+    }
+    kprintf("Frames: %zu free of %zu, %zu pre-zeroed\n",
+            free_frames, total_frames, zero_count);
+}
+
+static inline bool bit_test(uint32_t *map, uint32_t bit) {
+    return (map[bit >> 5] >> (bit & 31)) & 1;
+}
+
+static inline void bit_set(uint32_t *map, uint32_t bit) {
+    map[bit >> 5] |= 1u << (bit & 31);
+}
+
+static inline void bit_clear(uint32_t *map, uint32_t bit) {
+    map[bit >> 5] &= ~(1u << (bit & 31));
+}
+
+// Put the block headed by pfn on the order free list
+static void free_list_push(uint32_t pfn, unsigned order) {
+    struct frame *f = &frames[pfn];
+    f->prev = PFA_NONE;
+    f->next = free_head[order];
+    f->order = (uint8_t)order;
+    f->flags = FRAME_FREE;
+    if (free_head[order] != PFA_NONE) {
+        frames[free_head[order]].prev = pfn;
+    }
+    free_head[order] = pfn;
+    bit_set(free_bitmap[order], pfn >> order);
+}
+
+// Take the block headed by pfn off the order free list
+static void free_list_remove(uint32_t pfn, unsigned order) {
+    struct frame *f = &frames[pfn];
+    if (f->prev != PFA_NONE) {
+        frames[f->prev].next = f->next;
+    } else {
+        free_head[order] = f->next;
+    }
+    if (f->next != PFA_NONE) {
+        frames[f->next].prev = f->prev;
+    }
+    f->flags = 0;
+    bit_clear(free_bitmap[order], pfn >> order);
+}
+
+// Free a 2^order block, merging with its buddy for as long as possible
+static void buddy_free(uint32_t pfn, unsigned order) {
+    free_frames += (size_t)1 << order;
+
+    while (order < PFA_MAX_ORDER) {
+        uint32_t buddy = pfn ^ (1u << order);
+        if (buddy >= max_pfn || !bit_test(free_bitmap[order], buddy >> order)) {
+            break;
+        }
+        free_list_remove(buddy, order);
+        pfn &= ~(1u << order);
+        order++;
+    }
+
+    free_list_push(pfn, order);
+}
+
+// Does [start, end) overlap a reserved region?
+static bool range_reserved(uint64_t start, uint64_t end, uint64_t *res_end) {
+    for (size_t i = 0; i < region_count; i++) {
+        if (regions[i].type == MEMORY_FREE) {
+            continue;
+        }
+        uint64_t rs = regions[i].base;
+        uint64_t re = regions[i].base + regions[i].length;
+        if (rs < end && re > start) {
+            *res_end = re;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Release every non-reserved frame in [start, end) as maximal aligned blocks
+static void free_frame_range(uint32_t start, uint32_t end) {
+    while (start < end) {
+        uint64_t res_end;
+        if (range_reserved((uint64_t)start * PAGE_SIZE, (uint64_t)(start + 1) * PAGE_SIZE, &res_end)) {
+            start = (uint32_t)((res_end + PAGE_SIZE - 1) / PAGE_SIZE);
+            continue;
+        }
+
+        unsigned order = 0;
+        while (order < PFA_MAX_ORDER) {
+            uint32_t size = 2u << order;
+            if ((start & (size - 1)) != 0 || start + size > end) {
+                break;
+            }
+            if (range_reserved((uint64_t)start * PAGE_SIZE, (uint64_t)(start + size) * PAGE_SIZE, &res_end)) {
+                break;
+            }
+            order++;
+        }
+
+        buddy_free(start, order);
+        total_frames += (size_t)1 << order;
+        start += 1u << order;
+    }
+}
+
+// Build the frame table and free lists from the recorded memory map
+void pfa_init(void) {
+    uintptr_t kernel_end = ((uintptr_t)_kernel_end + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1);
+
+    max_pfn = 0;
+    total_frames = 0;
+    free_frames = 0;
+    zero_count = 0;
+    zero_hits = 0;
+    zero_misses = 0;
+    for (unsigned k = 0; k <= PFA_MAX_ORDER; k++) {
+        free_head[k] = PFA_NONE;
+    }
+
+    // Highest usable frame below the direct-mapped limit
+    for (size_t i = 0; i < region_count; i++) {
+        if (regions[i].type != MEMORY_FREE) {
+            continue;
+        }
+        uint64_t end = regions[i].base + regions[i].length;
+        if (end > MM_PHYS_LIMIT) {
+            end = MM_PHYS_LIMIT;
+        }
+        if (end / PAGE_SIZE > max_pfn) {
+            max_pfn = (uint32_t)(end / PAGE_SIZE);
+        }
+    }
+    if (max_pfn == 0) {
+        return;
+    }
+
+    // Frame table followed by one bitmap per order
+    size_t meta = (size_t)max_pfn * sizeof(struct frame);
+    for (unsigned k = 0; k <= PFA_MAX_ORDER; k++) {
+        meta += (((max_pfn >> k) + 32) / 32) * sizeof(uint32_t);
+    }
+    meta = (meta + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+
+    // Place the metadata in the first free region above the kernel image
+    uintptr_t meta_base = 0;
+    for (size_t i = 0; i < region_count && meta_base == 0; i++) {
+        if (regions[i].type != MEMORY_FREE) {
+            continue;
+        }
+        uint64_t start = regions[i].base;
+        uint64_t end = regions[i].base + regions[i].length;
+        uint64_t res_end;
+        if (start < kernel_end) {
+            start = kernel_end;
+        }
+        start = (start + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+        if (end > MM_PHYS_LIMIT) {
+            end = MM_PHYS_LIMIT;
+        }
+        if (start + meta <= end && !range_reserved(start, start + meta, &res_end)) {
+            meta_base = (uintptr_t)start;
+        }
+    }
+    if (meta_base == 0) {
+        max_pfn = 0;
+        return;
+    }
+
+    frames = (struct frame*)meta_base;
+    uint8_t *p = (uint8_t*)meta_base + (size_t)max_pfn * sizeof(struct frame);
+    for (unsigned k = 0; k <= PFA_MAX_ORDER; k++) {
+        size_t words = ((max_pfn >> k) + 32) / 32;
+        free_bitmap[k] = (uint32_t*)p;
+        for (size_t w = 0; w < words; w++) {
+            free_bitmap[k][w] = 0;
+        }
+        p += words * sizeof(uint32_t);
+    }
+    for (uint32_t pfn = 0; pfn < max_pfn; pfn++) {
+        frames[pfn].next = frames[pfn].prev = PFA_NONE;
+        frames[pfn].refcount = 0;
+        frames[pfn].order = 0;
+        frames[pfn].flags = 0;
+    }
+
+    // Low memory, the kernel image and the metadata are never handed out
+    mm_remove_region(0, kernel_end);
+    mm_remove_region(meta_base, meta);
+
+    for (size_t i = 0; i < region_count; i++) {
+        if (regions[i].type != MEMORY_FREE) {
+            continue;
+        }
+        uint64_t start = (regions[i].base + PAGE_SIZE - 1) / PAGE_SIZE;
+        uint64_t end = (regions[i].base + regions[i].length) / PAGE_SIZE;
+        if (end > max_pfn) {
+            end = max_pfn;
+        }
+        if (start < end) {
+            free_frame_range((uint32_t)start, (uint32_t)end);
+        }
+    }
+}
+
+// Allocate 2^order physically contiguous frames
+void* pfa_alloc_order(unsigned order) {
+    unsigned k = order;
+
+    if (order > PFA_MAX_ORDER) {
+        return NULL;
+    }
+    while (k <= PFA_MAX_ORDER && free_head[k] == PFA_NONE) {
+        k++;
+    }
+    if (k > PFA_MAX_ORDER) {
+        // Pre-zeroed frames are still frames
+        if (order == 0 && zero_count > 0) {
+            return zero_pool[--zero_count];
+        }
+        return NULL;
+    }
+
+    uint32_t pfn = free_head[k];
+    free_list_remove(pfn, k);
+
+    // Split off the upper halves until the block has the requested order
+    while (k > order) {
+        k--;
+        free_list_push(pfn + (1u << k), k);
+    }
+
+    frames[pfn].order = (uint8_t)order;
+    frames[pfn].flags = FRAME_ALLOC;
+    frames[pfn].refcount = 1;
+    free_frames -= (size_t)1 << order;
+    return (void*)((uintptr_t)pfn * PAGE_SIZE);
+}
+
+// Allocate a single frame
+void* pfa_alloc(void) {
+    return pfa_alloc_order(0);
+}
+
+// Allocate a single zero-filled frame, from the pre-zeroed pool if possible
+void* pfa_alloc_zeroed(void) {
+    if (zero_count > 0) {
+        zero_hits++;
+        return zero_pool[--zero_count];
+    }
+
+    zero_misses++;
+    void *page = pfa_alloc_order(0);
+    if (page != NULL) {
+        // Frames are reachable through the direct map
+        memset(page, 0, PAGE_SIZE);
+    }
+    return page;
+}
+
+// Idle-time work: zero one frame for the pool. Returns false when the pool
+// is full (or memory is short) and the CPU may halt.
+bool pfa_zero_idle(void) {
+    if (zero_count >= ZERO_POOL_SIZE || free_frames <= ZERO_POOL_SIZE) {
+        return false;
+    }
+
+    void *page = pfa_alloc_order(0);
+    if (page == NULL) {
+        return false;
+    }
+    memset(page, 0, PAGE_SIZE);
+    zero_pool[zero_count++] = page;
+    return true;
+}
+
+// Pool occupancy and how often pfa_alloc_zeroed() found it stocked
+void pfa_zero_stats(size_t* pooled, size_t* hits, size_t* misses) {
+    *pooled = zero_count;
+    *hits = zero_hits;
+    *misses = zero_misses;
+}
+
+// Drop a reference to a block returned by pfa_alloc()/pfa_alloc_order();
+// it goes back to the free lists when the last reference is gone
+void pfa_free(void* page) {
+    uint32_t pfn = (uint32_t)((uintptr_t)page / PAGE_SIZE);
+
+    if (page == NULL || pfn >= max_pfn || !(frames[pfn].flags & FRAME_ALLOC)) {
+        return;
+    }
+
+    if (frames[pfn].refcount > 1) {
+        frames[pfn].refcount--;
+        return;
+    }
+    frames[pfn].flags = 0;
+    frames[pfn].refcount = 0;
+    buddy_free(pfn, frames[pfn].order);
+}
+
+// Take another reference to an allocated frame (pages shared copy-on-write)
+bool pfa_ref(void* page) {
+    uint32_t pfn = (uint32_t)((uintptr_t)page / PAGE_SIZE);
+
+    if (pfn >= max_pfn || !(frames[pfn].flags & FRAME_ALLOC) || frames[pfn].refcount == UINT16_MAX) {
+        return false;
+    }
+    frames[pfn].refcount++;
+    return true;
+}
+
+// Number of references to an allocated frame (0 if it isn't allocated)
+unsigned pfa_refcount(void* page) {
+    uint32_t pfn = (uint32_t)((uintptr_t)page / PAGE_SIZE);
+
+    if (pfn >= max_pfn || !(frames[pfn].flags & FRAME_ALLOC)) {
+        return 0;
+    }
+    return frames[pfn].refcount;
+}
+
+// End of the highest frame the allocator manages
+uintptr_t pfa_max_address(void) {
+    return (uintptr_t)max_pfn * PAGE_SIZE;
+}
+
+// Frame accounting for mm_get_stats()
+size_t pfa_total_frames(void) {
+    return total_frames;
+}
+
+size_t pfa_free_frames(void) {
+    return free_frames;
+}
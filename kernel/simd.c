@@ -0,0 +1,99 @@
+#include "../include/kernel.h"
+#include "../include/kernel/cpu.h"
+#include "../include/kernel/simd.h"
+#include "../libc/mem.h"
+#include "../libc/mem_sse2.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// SSE2 for the bulk memory routines.
+//
+// Every kernel use of the XMM registers is wrapped in fxsave/fxrstor of
+// the whole FPU/SSE state, so it is invisible to whatever owned them
+// before. Interrupt handlers never use SIMD (they would need a save area
+// per nesting level); a fault taken in the middle of a SIMD copy finds
+// the registers claimed and falls back as well.
+
+static bool sse2_enabled;
+static bool simd_claimed;
+static uint8_t fx_area[512] __attribute__((aligned(16)));
+
+bool kernel_simd_begin(void) {
+    if (!sse2_enabled || simd_claimed || in_interrupt()) {
+        return false;
+    }
+    simd_claimed = true;
+    fxsave(fx_area);
+    return true;
+}
+
+void kernel_simd_end(void) {
+    fxrstor(fx_area);
+    simd_claimed = false;
+}
+
+static bool simd_copy(void* dest, const void* src, size_t num) {
+    if (!kernel_simd_begin()) {
+        return false;
+    }
+    mem_sse2_copy(dest, src, num);
+    kernel_simd_end();
+    return true;
+}
+
+static bool simd_set(void* ptr, int value, size_t num) {
+    if (!kernel_simd_begin()) {
+        return false;
+    }
+    mem_sse2_set(ptr, value, num);
+    kernel_simd_end();
+    return true;
+}
+
+static bool simd_compare(const void* ptr1, const void* ptr2, size_t num, int* result) {
+    if (!kernel_simd_begin()) {
+        return false;
+    }
+    *result = mem_sse2_compare(ptr1, ptr2, num);
+    kernel_simd_end();
+    return true;
+}
+
+static bool simd_find(const void* ptr, int value, size_t num, void** result) {
+    if (!kernel_simd_begin()) {
+        return false;
+    }
+    *result = mem_sse2_find(ptr, value, num);
+    kernel_simd_end();
+    return true;
+}
+
+static const struct mem_accel sse2_accel = {
+    .copy = simd_copy,
+    .set = simd_set,
+    .compare = simd_compare,
+    .find = simd_find,
+};
+
+void simd_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    uint32_t need = CPUID_EDX_FXSR | CPUID_EDX_SSE | CPUID_EDX_SSE2;
+    if ((edx & need) != need) {
+        return;
+    }
+
+    // FPU instructions execute natively and never trap
+    write_cr0((read_cr0() & ~(CR0_EM | CR0_TS)) | CR0_MP);
+    write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+    __asm__ volatile("fninit");
+
+    sse2_enabled = true;
+    mem_set_accel(&sse2_accel);
+}
+
+bool simd_enabled(void) {
+    return sse2_enabled;
+}
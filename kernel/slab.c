@@ -0,0 +1,307 @@
+#include "../include/kernel.h"
+#include "../include/kernel/mm.h"
+#include "../include/kernel/slab.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Object caches in the style of Bonwick's slab allocator.
+//
+// A slab is a naturally aligned run of 2^order frames from the buddy
+// allocator, so the slab header of any object is found by masking its
+// address. The free-list link of an object lives in a word after the
+// object itself, which keeps constructed state intact while the object
+// sits in the cache. Successive slabs start their objects at different
+// cache-line offsets ("colours") so equally indexed objects of different
+// slabs don't compete for the same cache sets.
+
+#define KMEM_CACHE_LINE     64
+#define KMEM_MIN_OBJECTS    8       // Grow the slab order until this many fit
+#define KMEM_MAX_ORDER      3
+
+struct kmem_slab {
+    struct kmem_slab *next;
+    struct kmem_slab *prev;
+    void *free;             // First free object
+    uint16_t inuse;
+    uint16_t total;
+};
+
+struct kmem_cache {
+    char name[32];
+    size_t size;            // Requested object size
+    size_t slot;            // Object plus free-list link, aligned
+    size_t align;
+    size_t offset;          // First object, past the header and aligned
+    unsigned order;         // Slab is 2^order frames
+    uint16_t per_slab;      // Objects per slab
+    size_t colour_max;      // Largest colour offset, in bytes
+    size_t colour_next;     // Offset used by the next slab
+    void (*ctor)(void*);
+
+    struct kmem_slab *full;
+    struct kmem_slab *partial;
+    struct kmem_slab *empty;
+    size_t slabs_full;
+    size_t slabs_partial;
+    size_t slabs_empty;
+    size_t alloc_count;
+    size_t free_count;
+
+    struct kmem_cache *next;
+};
+
+#define SLAB_HDR_SIZE ((sizeof(struct kmem_slab) + KMEM_CACHE_LINE - 1) & ~(size_t)(KMEM_CACHE_LINE - 1))
+
+static struct kmem_cache *cache_list;
+
+// Free-list link stored after the object
+static inline void** obj_link(struct kmem_cache *c, void *obj) {
+    return (void**)((uint8_t*)obj + c->slot - sizeof(void*));
+}
+
+static inline size_t slab_bytes(struct kmem_cache *c) {
+    return (size_t)PAGE_SIZE << c->order;
+}
+
+// Bytes left for objects and colouring once the header is skipped
+static inline size_t slab_usable(struct kmem_cache *c) {
+    return slab_bytes(c) > c->offset ? slab_bytes(c) - c->offset : 0;
+}
+
+static inline struct kmem_slab* obj_to_slab(struct kmem_cache *c, void *obj) {
+    return (struct kmem_slab*)((uintptr_t)obj & ~(uintptr_t)(slab_bytes(c) - 1));
+}
+
+static void list_remove(struct kmem_slab **head, struct kmem_slab *s) {
+    if (s->prev) {
+        s->prev->next = s->next;
+    } else {
+        *head = s->next;
+    }
+    if (s->next) {
+        s->next->prev = s->prev;
+    }
+    s->next = s->prev = NULL;
+}
+
+static void list_push(struct kmem_slab **head, struct kmem_slab *s) {
+    s->prev = NULL;
+    s->next = *head;
+    if (*head) {
+        (*head)->prev = s;
+    }
+    *head = s;
+}
+
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, void (*ctor)(void*)) {
+    if (size == 0) {
+        return NULL;
+    }
+    if (align < sizeof(void*)) {
+        align = sizeof(void*);
+    }
+    if (align & (align - 1)) {
+        return NULL;
+    }
+
+    struct kmem_cache *c = kmalloc(sizeof(struct kmem_cache));
+    if (c == NULL) {
+        return NULL;
+    }
+
+    size_t i = 0;
+    for (; name && name[i] && i < sizeof(c->name) - 1; i++) {
+        c->name[i] = name[i];
+    }
+    c->name[i] = '\0';
+
+    c->size = size;
+    c->align = align;
+    c->slot = (size + sizeof(void*) + align - 1) & ~(align - 1);
+    c->offset = (SLAB_HDR_SIZE + align - 1) & ~(align - 1);
+    c->ctor = ctor;
+
+    c->order = 0;
+    while (c->order < KMEM_MAX_ORDER && slab_usable(c) / c->slot < KMEM_MIN_OBJECTS) {
+        c->order++;
+    }
+    if (slab_usable(c) / c->slot == 0) {
+        kfree(c);
+        return NULL;
+    }
+    size_t per_slab = slab_usable(c) / c->slot;
+    if (per_slab > UINT16_MAX) {
+        per_slab = UINT16_MAX;
+    }
+    c->per_slab = (uint16_t)per_slab;
+
+    // Leftover space is spent on colouring, one cache line at a time
+    size_t leftover = slab_usable(c) - (size_t)c->per_slab * c->slot;
+    size_t step = align > KMEM_CACHE_LINE ? align : KMEM_CACHE_LINE;
+    c->colour_max = leftover - leftover % step;
+    c->colour_next = 0;
+
+    c->full = c->partial = c->empty = NULL;
+    c->slabs_full = c->slabs_partial = c->slabs_empty = 0;
+    c->alloc_count = c->free_count = 0;
+
+    c->next = cache_list;
+    cache_list = c;
+    return c;
+}
+
+// Allocate, colour and construct a new slab; it starts on the empty list
+static struct kmem_slab* cache_grow(struct kmem_cache *c) {
+    struct kmem_slab *s = pfa_alloc_order(c->order);
+    if (s == NULL) {
+        return NULL;
+    }
+
+    size_t colour = c->colour_next;
+    size_t step = c->align > KMEM_CACHE_LINE ? c->align : KMEM_CACHE_LINE;
+    c->colour_next = (colour + step > c->colour_max) ? 0 : colour + step;
+
+    s->free = NULL;
+    s->inuse = 0;
+    s->total = c->per_slab;
+
+    uint8_t *base = (uint8_t*)s + c->offset + colour;
+    for (int i = c->per_slab - 1; i >= 0; i--) {
+        void *obj = base + (size_t)i * c->slot;
+        if (c->ctor) {
+            c->ctor(obj);
+        }
+        *obj_link(c, obj) = s->free;
+        s->free = obj;
+    }
+
+    list_push(&c->empty, s);
+    c->slabs_empty++;
+    return s;
+}
+
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    struct kmem_cache *c = cache;
+    struct kmem_slab *s = c->partial;
+
+    if (s == NULL) {
+        s = c->empty;
+        if (s == NULL && (s = cache_grow(c)) == NULL) {
+            return NULL;
+        }
+        list_remove(&c->empty, s);
+        c->slabs_empty--;
+        list_push(&c->partial, s);
+        c->slabs_partial++;
+    }
+
+    void *obj = s->free;
+    s->free = *obj_link(c, obj);
+    s->inuse++;
+    c->alloc_count++;
+
+    if (s->free == NULL) {
+        list_remove(&c->partial, s);
+        c->slabs_partial--;
+        list_push(&c->full, s);
+        c->slabs_full++;
+    }
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    struct kmem_cache *c = cache;
+
+    if (obj == NULL) {
+        return;
+    }
+
+    struct kmem_slab *s = obj_to_slab(c, obj);
+    bool was_full = (s->free == NULL);
+
+    *obj_link(c, obj) = s->free;
+    s->free = obj;
+    s->inuse--;
+    c->free_count++;
+
+    if (was_full) {
+        list_remove(&c->full, s);
+        c->slabs_full--;
+        list_push(&c->partial, s);
+        c->slabs_partial++;
+    }
+
+    if (s->inuse == 0) {
+        list_remove(&c->partial, s);
+        c->slabs_partial--;
+
+        // Keep one empty slab around to absorb alloc/free ping-pong
+        if (c->empty != NULL) {
+            pfa_free(s);
+        } else {
+            list_push(&c->empty, s);
+            c->slabs_empty++;
+        }
+    }
+}
+
+void kmem_cache_shrink(kmem_cache_t* cache) {
+    struct kmem_cache *c = cache;
+
+    while (c->empty != NULL) {
+        struct kmem_slab *s = c->empty;
+        list_remove(&c->empty, s);
+        pfa_free(s);
+    }
+    c->slabs_empty = 0;
+}
+
+void kmem_cache_destroy(kmem_cache_t* cache) {
+    struct kmem_cache *c = cache;
+
+    if (c == NULL) {
+        return;
+    }
+
+    kmem_cache_shrink(c);
+    while (c->partial != NULL) {
+        struct kmem_slab *s = c->partial;
+        list_remove(&c->partial, s);
+        pfa_free(s);
+    }
+    while (c->full != NULL) {
+        struct kmem_slab *s = c->full;
+        list_remove(&c->full, s);
+        pfa_free(s);
+    }
+
+    for (struct kmem_cache **pp = &cache_list; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == c) {
+            *pp = c->next;
+            break;
+        }
+    }
+    kfree(c);
+}
+
+void kmem_cache_get_stats(kmem_cache_t* cache, kmem_cache_stats_t* stats) {
+    struct kmem_cache *c = cache;
+    size_t slabs = c->slabs_full + c->slabs_partial + c->slabs_empty;
+
+    stats->name = c->name;
+    stats->object_size = c->size;
+    stats->slot_size = c->slot;
+    stats->slab_pages = (size_t)1 << c->order;
+    stats->objects_total = slabs * c->per_slab;
+    stats->objects_inuse = c->alloc_count - c->free_count;
+    stats->slabs_full = c->slabs_full;
+    stats->slabs_partial = c->slabs_partial;
+    stats->slabs_empty = c->slabs_empty;
+    stats->alloc_count = c->alloc_count;
+    stats->free_count = c->free_count;
+}
+
+kmem_cache_t* kmem_cache_next(kmem_cache_t* cache) {
+    return cache ? cache->next : cache_list;
+}
@@ -0,0 +1,90 @@
+#include "../include/kernel.h"
+#include "../include/kernel/mm.h"
+#include "../include/kernel/syscall.h"
+#include "../include/kernel/task.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Memory system calls. sbrk and mmap are thin layers over demand-zero
+// areas (kernel/vma.c): nothing is allocated until a page is first touched.
+
+static inline uintptr_t page_round_up(uintptr_t addr) {
+    return (addr + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1);
+}
+
+// Move the program break of the current address space (it grows up from
+// MM_USER_START); returns the old break, or (void*)-1 on failure
+void* sys_sbrk(intptr_t increment) {
+    mm_space_t *space = mm_space_current();
+    uintptr_t old = space->brk;
+
+    if (increment > 0) {
+        if ((uintptr_t)increment > MM_MMAP_START - old) {
+            return (void*)-1;
+        }
+        uintptr_t start = page_round_up(old);
+        uintptr_t end = page_round_up(old + (uintptr_t)increment);
+        if (end > start && vma_reserve((void*)start, end - start, VMA_READ | VMA_WRITE) == NULL) {
+            return (void*)-1;
+        }
+    } else if (increment < 0) {
+        if ((uintptr_t)-increment > old - MM_USER_START) {
+            return (void*)-1;
+        }
+        uintptr_t start = page_round_up(old + (uintptr_t)increment);
+        uintptr_t end = page_round_up(old);
+        if (end > start) {
+            vma_release((void*)start, end - start);
+        }
+    }
+
+    space->brk = old + (uintptr_t)increment;
+    return (void*)old;
+}
+
+// Anonymous mappings only; fd and offset are ignored
+void* sys_mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    (void)fd;
+    (void)offset;
+
+    if (length == 0 || !(flags & MAP_ANONYMOUS)) {
+        return MAP_FAILED;
+    }
+
+    uint32_t vma_prot = 0;
+    if (prot & PROT_READ) {
+        vma_prot |= VMA_READ;
+    }
+    if (prot & PROT_WRITE) {
+        vma_prot |= VMA_READ | VMA_WRITE;
+    }
+
+    void *result;
+    if (flags & MAP_FIXED) {
+        // A fixed mapping replaces whatever was there
+        if ((uintptr_t)addr < MM_MMAP_START) {
+            return MAP_FAILED;
+        }
+        result = vma_replace(addr, length, vma_prot);
+    } else {
+        result = vma_reserve(NULL, length, vma_prot);
+    }
+    return result != NULL ? result : MAP_FAILED;
+}
+
+int32_t sys_munmap(void* addr, size_t length) {
+    if ((uintptr_t)addr < MM_MMAP_START) {
+        return -1;
+    }
+    return vma_release(addr, length);
+}
+
+// Fork the caller: the child gets a copy-on-write clone of the address
+// space (areas, break and every faulted-in page) and a task record of its
+// own. There is no scheduler or user mode yet, so the child stays READY
+// and only the parent's side of the call happens: it gets the child's pid.
+int32_t sys_fork(void) {
+    task_t *child = task_fork();
+    return child != NULL ? (int32_t)child->pid : -1;
+}
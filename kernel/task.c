@@ -0,0 +1,77 @@
+#include "../include/kernel.h"
+#include "../include/kernel/mm.h"
+#include "../include/kernel/task.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Task records. There is no scheduler or user mode yet, so this is only the
+// bookkeeping fork needs: the boot task, and children that own a
+// copy-on-write clone of their parent's address space and wait, READY, for
+// something to switch to them (mm_space_switch() on task->space).
+
+static task_t boot_task = {
+    .pid = 1,
+    .state = TASK_RUNNING,
+    .priority = PRIORITY_NORMAL,
+    .name = "kernel",
+};
+static task_t *current = &boot_task;
+static uint32_t next_pid = 2;
+static uint32_t tasks = 1;
+
+// Adopt the address space the kernel booted in (after vma_init)
+void tasking_init(void) {
+    boot_task.space = mm_space_current();
+    boot_task.page_directory = (uint32_t)(uintptr_t)boot_task.space->dir;
+    boot_task.context.cr3 = boot_task.page_directory;
+    boot_task.next = boot_task.prev = &boot_task;
+}
+
+task_t* task_current(void) {
+    return current;
+}
+
+uint32_t task_count(void) {
+    return tasks;
+}
+
+task_t* task_fork(void) {
+    task_t *child = kmalloc(sizeof(task_t));
+    if (child == NULL) {
+        return NULL;
+    }
+    mm_space_t *space = mm_space_clone();
+    if (space == NULL) {
+        kfree(child);
+        return NULL;
+    }
+
+    memcpy(child, current, sizeof(task_t));
+    child->pid = next_pid++;
+    child->ppid = current->pid;
+    child->state = TASK_READY;
+    child->space = space;
+    child->page_directory = (uint32_t)(uintptr_t)space->dir;
+    child->context.cr3 = child->page_directory;
+
+    // Link in after the parent
+    child->prev = current;
+    child->next = current->next;
+    current->next->prev = child;
+    current->next = child;
+    tasks++;
+    return child;
+}
+
+void task_destroy(task_t* task) {
+    if (task == NULL || task == current || task == &boot_task) {
+        return;
+    }
+    task->prev->next = task->next;
+    task->next->prev = task->prev;
+    tasks--;
+    mm_space_destroy(task->space);
+    kfree(task);
+}
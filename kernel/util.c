@@ -0,0 +1,502 @@
+#include "../include/kernel.h"
+#include "../include/kernel/util.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Kernel utility library.
+//
+// Decimal conversion emits two digits per division from a 100-entry pair
+// table; hex and the other power-of-two bases use shifts only. 64-bit
+// values are split into 32-bit divisions (kdiv64) instead of going
+// through the compiler's __udivdi3, which this kernel doesn't link.
+
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char hex_upper[] = "0123456789ABCDEF";
+static const char digits_lower[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+static const uint32_t powers_of_10[] = {
+    10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/* ---- Number formatting ---- */
+
+uint32_t kdiv64(uint64_t* n, uint32_t base) {
+    uint32_t hi = (uint32_t)(*n >> 32);
+    uint32_t lo = (uint32_t)*n;
+    uint32_t q_hi = hi / base;
+    uint32_t rem = hi % base;
+    uint32_t q_lo;
+
+    // rem < base, so (rem:lo) / base fits in 32 bits
+    __asm__("divl %4" : "=a"(q_lo), "=d"(rem) : "a"(lo), "d"(rem), "rm"(base));
+    *n = ((uint64_t)q_hi << 32) | q_lo;
+    return rem;
+}
+
+// Number of decimal digits in value
+static unsigned dec_digits(uint32_t value) {
+    unsigned n = 1;
+    while (n < 10 && value >= powers_of_10[n - 1]) {
+        n++;
+    }
+    return n;
+}
+
+// Write value as exactly len digits (zero padded) at buf
+static void put_dec(char* buf, uint32_t value, unsigned len) {
+    char* p = buf + len;
+
+    while (value >= 100) {
+        unsigned pair = (value % 100) * 2;
+        value /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if (value >= 10) {
+        *--p = digit_pairs[value * 2 + 1];
+        *--p = digit_pairs[value * 2];
+    } else {
+        *--p = (char)('0' + value);
+    }
+    while (p > buf) {
+        *--p = '0';
+    }
+}
+
+size_t kfmt_dec(char* buf, uint32_t value) {
+    unsigned len = dec_digits(value);
+    put_dec(buf, value, len);
+    buf[len] = '\0';
+    return len;
+}
+
+size_t kfmt_dec64(char* buf, uint64_t value) {
+    if (value <= UINT32_MAX) {
+        return kfmt_dec(buf, (uint32_t)value);
+    }
+
+    // Peel off nine-digit groups: at most three for a 64-bit value
+    uint32_t low = kdiv64(&value, 1000000000);
+    uint32_t mid = 0;
+    bool has_mid = value > UINT32_MAX;
+    if (has_mid) {
+        mid = kdiv64(&value, 1000000000);
+    }
+
+    size_t len = kfmt_dec(buf, (uint32_t)value);
+    if (has_mid) {
+        put_dec(buf + len, mid, 9);
+        len += 9;
+    }
+    put_dec(buf + len, low, 9);
+    len += 9;
+    buf[len] = '\0';
+    return len;
+}
+
+// Digits of value in a power-of-two base (1 << shift), at least width of
+// them, written to buf
+static size_t put_pow2(char* buf, uint64_t value, unsigned shift, int width, const char* digits) {
+    unsigned mask = (1u << shift) - 1;
+    unsigned len = 1;
+    while (len * shift < 64 && (value >> (len * shift)) != 0) {
+        len++;
+    }
+    if (width > (int)len) {
+        len = (unsigned)width;
+    }
+
+    for (unsigned i = len; i > 0; i--) {
+        buf[i - 1] = digits[value & mask];
+        value >>= shift;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+size_t kfmt_hex(char* buf, uint32_t value, int width) {
+    return put_pow2(buf, value, 4, width > 8 ? 8 : width, hex_upper);
+}
+
+size_t kfmt_hex64(char* buf, uint64_t value, int width) {
+    return put_pow2(buf, value, 4, width > 16 ? 16 : width, hex_upper);
+}
+
+// Unsigned value in any base from 2 to 36 (lowercase letters)
+static char* format_unsigned(uint64_t value, char* str, int base) {
+    if (base < 2 || base > 36) {
+        str[0] = '\0';
+        return str;
+    }
+    if (base == 10) {
+        kfmt_dec64(str, value);
+        return str;
+    }
+    if ((base & (base - 1)) == 0) {
+        put_pow2(str, value, (unsigned)__builtin_ctz((unsigned)base), 0, digits_lower);
+        return str;
+    }
+
+    char tmp[65];
+    char* p = tmp + sizeof(tmp) - 1;
+    *p = '\0';
+    do {
+        uint32_t digit;
+        if (value <= UINT32_MAX) {
+            digit = (uint32_t)value % (uint32_t)base;
+            value = (uint32_t)value / (uint32_t)base;
+        } else {
+            digit = kdiv64(&value, (uint32_t)base);
+        }
+        *--p = digits_lower[digit];
+    } while (value != 0);
+
+    memcpy(str, p, (size_t)(tmp + sizeof(tmp) - p));
+    return str;
+}
+
+// Negative numbers get a sign in base 10 only; other bases show the bits
+static char* format_signed(long long value, unsigned long long as_unsigned, char* str, int base) {
+    if (base == 10 && value < 0) {
+        str[0] = '-';
+        format_unsigned(0 - (unsigned long long)value, str + 1, base);
+        return str;
+    }
+    return format_unsigned(as_unsigned, str, base);
+}
+
+char* kitoa(int value, char* str, int base) {
+    return format_signed(value, (unsigned int)value, str, base);
+}
+
+char* kltoa(long value, char* str, int base) {
+    return format_signed(value, (unsigned long)value, str, base);
+}
+
+char* klltoa(long long value, char* str, int base) {
+    return format_signed(value, (unsigned long long)value, str, base);
+}
+
+char* kultoa(unsigned long value, char* str, int base) {
+    return format_unsigned(value, str, base);
+}
+
+char* kulltoa(unsigned long long value, char* str, int base) {
+    return format_unsigned(value, str, base);
+}
+
+/* ---- Number parsing ---- */
+
+// Decimal digits after optional whitespace and sign; wraps on overflow
+static unsigned long long parse_dec(const char* str, bool* negative) {
+    unsigned long long result = 0;
+
+    while (kisspace((unsigned char)*str)) {
+        str++;
+    }
+    *negative = false;
+    if (*str == '-' || *str == '+') {
+        *negative = *str == '-';
+        str++;
+    }
+    while (kisdigit((unsigned char)*str)) {
+        result = result * 10 + (unsigned)(*str - '0');
+        str++;
+    }
+    return result;
+}
+
+int katoi(const char* str) {
+    bool negative;
+    unsigned long long value = parse_dec(str, &negative);
+    return (int)(negative ? 0 - value : value);
+}
+
+long katol(const char* str) {
+    bool negative;
+    unsigned long long value = parse_dec(str, &negative);
+    return (long)(negative ? 0 - value : value);
+}
+
+long long katoll(const char* str) {
+    bool negative;
+    unsigned long long value = parse_dec(str, &negative);
+    return (long long)(negative ? 0 - value : value);
+}
+
+unsigned long katoul(const char* str) {
+    bool negative;
+    unsigned long long value = parse_dec(str, &negative);
+    return (unsigned long)(negative ? 0 - value : value);
+}
+
+unsigned long long katoull(const char* str) {
+    bool negative;
+    unsigned long long value = parse_dec(str, &negative);
+    return negative ? 0 - value : value;
+}
+
+/* ---- Strings and memory ---- */
+
+size_t kstrlen(const char* str) {
+    return strlen(str);
+}
+
+int kstrcmp(const char* s1, const char* s2) {
+    return strcmp(s1, s2);
+}
+
+int kstrncmp(const char* s1, const char* s2, size_t n) {
+    return strncmp(s1, s2, n);
+}
+
+char* kstrcpy(char* dest, const char* src) {
+    return strcpy(dest, src);
+}
+
+char* kstrncpy(char* dest, const char* src, size_t n) {
+    return strncpy(dest, src, n);
+}
+
+char* kstrcat(char* dest, const char* src) {
+    strcpy(dest + strlen(dest), src);
+    return dest;
+}
+
+char* kstrncat(char* dest, const char* src, size_t n) {
+    char* p = dest + strlen(dest);
+    while (n-- > 0 && *src) {
+        *p++ = *src++;
+    }
+    *p = '\0';
+    return dest;
+}
+
+char* kstrchr(const char* str, int c) {
+    char ch = (char)c;
+    while (*str != ch) {
+        if (*str == '\0') {
+            return NULL;
+        }
+        str++;
+    }
+    return (char*)str;
+}
+
+char* kstrrchr(const char* str, int c) {
+    char ch = (char)c;
+    const char* last = NULL;
+    do {
+        if (*str == ch) {
+            last = str;
+        }
+    } while (*str++);
+    return (char*)last;
+}
+
+char* kstrstr(const char* haystack, const char* needle) {
+    size_t len = strlen(needle);
+    if (len == 0) {
+        return (char*)haystack;
+    }
+    for (; (haystack = kstrchr(haystack, needle[0])) != NULL; haystack++) {
+        if (strncmp(haystack, needle, len) == 0) {
+            return (char*)haystack;
+        }
+    }
+    return NULL;
+}
+
+char* kstrtok(char* str, const char* delimiters) {
+    static char* next;
+    if (str == NULL) {
+        str = next;
+    }
+    if (str == NULL) {
+        return NULL;
+    }
+
+    while (*str && kstrchr(delimiters, *str)) {
+        str++;
+    }
+    if (*str == '\0') {
+        next = NULL;
+        return NULL;
+    }
+
+    char* token = str;
+    while (*str && !kstrchr(delimiters, *str)) {
+        str++;
+    }
+    if (*str) {
+        *str++ = '\0';
+        next = str;
+    } else {
+        next = NULL;
+    }
+    return token;
+}
+
+void* kmemset(void* ptr, int value, size_t num) {
+    return memset(ptr, value, num);
+}
+
+void* kmemcpy(void* dest, const void* src, size_t num) {
+    return memcpy(dest, src, num);
+}
+
+void* kmemmove(void* dest, const void* src, size_t num) {
+    return memmove(dest, src, num);
+}
+
+int kmemcmp(const void* ptr1, const void* ptr2, size_t num) {
+    return memcmp(ptr1, ptr2, num);
+}
+
+void* kmemchr(const void* ptr, int value, size_t num) {
+    return memchr(ptr, value, num);
+}
+
+/* ---- Characters (ASCII) ---- */
+
+int kisalpha(int c) {
+    return kislower(c) || kisupper(c);
+}
+
+int kisdigit(int c) {
+    return c >= '0' && c <= '9';
+}
+
+int kisalnum(int c) {
+    return kisalpha(c) || kisdigit(c);
+}
+
+int kiscntrl(int c) {
+    return (c >= 0 && c < 32) || c == 127;
+}
+
+int kisgraph(int c) {
+    return c > ' ' && c < 127;
+}
+
+int kislower(int c) {
+    return c >= 'a' && c <= 'z';
+}
+
+int kisupper(int c) {
+    return c >= 'A' && c <= 'Z';
+}
+
+int kisprint(int c) {
+    return c >= ' ' && c < 127;
+}
+
+int kispunct(int c) {
+    return kisgraph(c) && !kisalnum(c);
+}
+
+int kisspace(int c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+int ktoupper(int c) {
+    return kislower(c) ? c - 'a' + 'A' : c;
+}
+
+int ktolower(int c) {
+    return kisupper(c) ? c - 'A' + 'a' : c;
+}
+
+/* ---- Bits and math ---- */
+
+uint8_t kbit_set(uint8_t byte, uint8_t bit) {
+    return byte | (uint8_t)(1u << (bit & 7));
+}
+
+uint8_t kbit_clear(uint8_t byte, uint8_t bit) {
+    return byte & (uint8_t)~(1u << (bit & 7));
+}
+
+uint8_t kbit_toggle(uint8_t byte, uint8_t bit) {
+    return byte ^ (uint8_t)(1u << (bit & 7));
+}
+
+bool kbit_check(uint8_t byte, uint8_t bit) {
+    return (byte >> (bit & 7)) & 1;
+}
+
+int kabs(int n) {
+    return n < 0 ? -n : n;
+}
+
+long int klabs(long int n) {
+    return n < 0 ? -n : n;
+}
+
+long long int kllabs(long long int n) {
+    return n < 0 ? -n : n;
+}
+
+/* ---- Debugging ---- */
+
+// Sixteen bytes per line: address, hex bytes, printable characters
+void khexdump(const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    for (size_t offset = 0; offset < size; offset += 16) {
+        char line[80];
+        char* p = line;
+
+        p += kfmt_hex(p, (uint32_t)(uintptr_t)(bytes + offset), 8);
+        *p++ = ':';
+        for (size_t i = 0; i < 16; i++) {
+            *p++ = ' ';
+            if (offset + i < size) {
+                *p++ = hex_upper[bytes[offset + i] >> 4];
+                *p++ = hex_upper[bytes[offset + i] & 0xF];
+            } else {
+                *p++ = ' ';
+                *p++ = ' ';
+            }
+        }
+        *p++ = ' ';
+        *p++ = '|';
+        for (size_t i = 0; i < 16 && offset + i < size; i++) {
+            uint8_t c = bytes[offset + i];
+            *p++ = kisprint(c) ? (char)c : '.';
+        }
+        *p++ = '|';
+        *p++ = '\n';
+        *p = '\0';
+        kprint(line);
+    }
+}
+
+// Return addresses up the saved-frame-pointer chain
+void kstacktrace(void) {
+    struct frame {
+        struct frame* next;
+        uintptr_t ret;
+    };
+    struct frame* f = (struct frame*)__builtin_frame_address(0);
+
+    kprint("Stack trace:\n");
+    for (int depth = 0; f != NULL && f->ret != 0 && depth < 16; depth++) {
+        char line[24] = "  0x";
+        kfmt_hex(line + 4, (uint32_t)f->ret, 8);
+        kprint(line);
+        kprint("\n");
+
+        // Callers' frames sit higher up the stack
+        if (f->next <= f) {
+            break;
+        }
+        f = f->next;
+    }
+}
@@ -0,0 +1,300 @@
+#include "../include/kernel.h"
+#include "../include/kernel/mm.h"
+#include "../include/kernel/cpu.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Demand-zero virtual memory areas.
+//
+// An area is a reserved range of virtual addresses with nothing mapped
+// behind it. The first access to each page raises a page fault; the
+// handler takes a frame, clears it through the direct map and maps it with
+// the area's protection. Large reservations therefore cost one table slot
+// until they are actually used.
+//
+// Areas belong to an address space (mm_space_t) together with its page
+// directory and program break, so cloning a space for fork carries the
+// areas over and the child's demand faults see the same layout.
+
+// Page fault error code bits
+#define PF_PRESENT  0x1     // Protection violation (page was present)
+#define PF_WRITE    0x2     // Faulting access was a write
+#define PF_USER     0x4     // Fault happened in ring 3
+
+// The space the kernel booted in, and the one whose areas are in use
+static mm_space_t boot_space = { .brk = MM_USER_START };
+static mm_space_t *space = &boot_space;
+
+static inline uintptr_t page_round_up(uintptr_t addr) {
+    return (addr + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1);
+}
+
+// Is [start, start + length) a page-aligned range inside the user window?
+static inline bool vma_range_ok(uintptr_t start, size_t length) {
+    return length != 0 && !(start & (PAGE_SIZE - 1)) && start >= MM_USER_START &&
+           start <= MM_USER_END && MM_USER_END - start >= length;
+}
+
+// Area containing addr, or NULL
+static struct vm_area* vma_find(uintptr_t addr) {
+    for (size_t i = 0; i < space->area_count && space->areas[i].start <= addr; i++) {
+        if (addr < space->areas[i].end) {
+            return &space->areas[i];
+        }
+    }
+    return NULL;
+}
+
+// Insert [start, end) at its sorted position, merging with neighbours that
+// touch it and share its protection
+static bool vma_insert(uintptr_t start, uintptr_t end, uint32_t prot) {
+    size_t i = 0;
+    while (i < space->area_count && space->areas[i].start < start) {
+        i++;
+    }
+
+    bool merge_prev = i > 0 && space->areas[i - 1].end == start && space->areas[i - 1].prot == prot;
+    bool merge_next = i < space->area_count && space->areas[i].start == end && space->areas[i].prot == prot;
+
+    if (merge_prev && merge_next) {
+        space->areas[i - 1].end = space->areas[i].end;
+        memmove(&space->areas[i], &space->areas[i + 1], (space->area_count - i - 1) * sizeof(struct vm_area));
+        space->area_count--;
+    } else if (merge_prev) {
+        space->areas[i - 1].end = end;
+    } else if (merge_next) {
+        space->areas[i].start = start;
+    } else {
+        if (space->area_count == VMA_MAX) {
+            return false;
+        }
+        memmove(&space->areas[i + 1], &space->areas[i], (space->area_count - i) * sizeof(struct vm_area));
+        space->areas[i].start = start;
+        space->areas[i].end = end;
+        space->areas[i].prot = prot;
+        space->area_count++;
+    }
+    return true;
+}
+
+// Does [start, end) overlap any area?
+static bool vma_overlaps(uintptr_t start, uintptr_t end) {
+    for (size_t i = 0; i < space->area_count && space->areas[i].start < end; i++) {
+        if (space->areas[i].end > start) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Lowest gap of at least length bytes in the mmap range
+static uintptr_t vma_find_gap(size_t length) {
+    uintptr_t start = MM_MMAP_START;
+
+    for (size_t i = 0; i < space->area_count; i++) {
+        if (space->areas[i].end <= start) {
+            continue;
+        }
+        if (space->areas[i].start >= start && space->areas[i].start - start >= length) {
+            break;
+        }
+        start = space->areas[i].end;
+    }
+    if (start > MM_USER_END || MM_USER_END - start < length) {
+        return 0;
+    }
+    return start;
+}
+
+// Reserve length bytes of demand-zero memory at addr (page aligned), or
+// wherever there is room above MM_MMAP_START when addr is NULL. Returns the
+// start of the area, or NULL on failure.
+void* vma_reserve(void* addr, size_t length, uint32_t prot) {
+    uintptr_t start = (uintptr_t)addr;
+
+    if (length == 0 || (start & (PAGE_SIZE - 1))) {
+        return NULL;
+    }
+    length = page_round_up(length);
+
+    if (addr == NULL) {
+        start = vma_find_gap(length);
+        if (start == 0) {
+            return NULL;
+        }
+    } else if (!vma_range_ok(start, length)) {
+        return NULL;
+    }
+
+    if (vma_overlaps(start, start + length) || !vma_insert(start, start + length, prot)) {
+        return NULL;
+    }
+    return (void*)start;
+}
+
+// Drop [addr, addr + length) from every area it touches (splitting areas
+// as needed) and free the frames that were faulted in
+int vma_release(void* addr, size_t length) {
+    uintptr_t start = (uintptr_t)addr;
+    uintptr_t end;
+
+    // MM_USER_END is page aligned, so rounding length up stays inside
+    if (!vma_range_ok(start, length)) {
+        return -1;
+    }
+    end = start + page_round_up(length);
+
+    for (size_t i = 0; i < space->area_count; i++) {
+        struct vm_area *a = &space->areas[i];
+        if (a->end <= start || a->start >= end) {
+            continue;
+        }
+
+        if (a->start < start && a->end > end) {
+            // Punching a hole: the tail becomes an area of its own
+            if (space->area_count == VMA_MAX) {
+                return -1;
+            }
+            memmove(&space->areas[i + 2], &space->areas[i + 1], (space->area_count - i - 1) * sizeof(struct vm_area));
+            space->areas[i + 1].start = end;
+            space->areas[i + 1].end = a->end;
+            space->areas[i + 1].prot = a->prot;
+            space->area_count++;
+            a->end = start;
+            break;
+        }
+        if (a->start < start) {
+            a->end = start;
+        } else if (a->end > end) {
+            a->start = end;
+        } else {
+            memmove(&space->areas[i], &space->areas[i + 1], (space->area_count - i - 1) * sizeof(struct vm_area));
+            space->area_count--;
+            i--;
+        }
+    }
+
+    vmm_unmap_range((void*)start, end - start);
+    return 0;
+}
+
+// Number of areas left once [start, end) is released
+static size_t vma_count_after_release(uintptr_t start, uintptr_t end) {
+    size_t count = space->area_count;
+
+    for (size_t i = 0; i < space->area_count && space->areas[i].start < end; i++) {
+        if (space->areas[i].end <= start) {
+            continue;
+        }
+        if (space->areas[i].start < start && space->areas[i].end > end) {
+            count++;
+        } else if (space->areas[i].start >= start && space->areas[i].end <= end) {
+            count--;
+        }
+    }
+    return count;
+}
+
+// Replace whatever is mapped in [addr, addr + length) with a fresh
+// demand-zero area. Everything is checked up front, so on failure the old
+// mappings are left alone.
+void* vma_replace(void* addr, size_t length, uint32_t prot) {
+    uintptr_t start = (uintptr_t)addr;
+
+    if (!vma_range_ok(start, length)) {
+        return NULL;
+    }
+    length = page_round_up(length);
+    if (vma_count_after_release(start, start + length) >= VMA_MAX) {
+        return NULL;
+    }
+
+    vma_release(addr, length);
+    return vma_reserve(addr, length, prot);
+}
+
+// Back the page holding addr with a zeroed frame
+static bool vma_fill(struct vm_area *a, uintptr_t addr) {
+    void *page = (void*)(addr & ~(uintptr_t)(PAGE_SIZE - 1));
+    void *frame = pfa_alloc_zeroed();
+    if (frame == NULL) {
+        return false;
+    }
+
+    uint32_t flags = VMM_USER;
+    if (a->prot & VMA_WRITE) {
+        flags |= VMM_WRITE;
+    }
+    if (vmm_map_page_flags(frame, page, flags) == NULL) {
+        pfa_free(frame);
+        return false;
+    }
+    return true;
+}
+
+// ISR 14: fill demand-zero pages and break copy-on-write sharing; anything
+// else is fatal
+static void page_fault_handler(registers_t *regs) {
+    uintptr_t addr = read_cr2();
+
+    if ((regs->err_code & PF_PRESENT) && (regs->err_code & PF_WRITE)) {
+        if (vmm_handle_cow((void*)addr)) {
+            return;
+        }
+    } else if (!(regs->err_code & PF_PRESENT)) {
+        struct vm_area *a = vma_find(addr);
+        uint32_t need = (regs->err_code & PF_WRITE) ? VMA_WRITE : VMA_READ;
+        bool allowed = a != NULL && (a->prot & need);
+        if (allowed && vma_fill(a, addr)) {
+            return;
+        }
+    }
+
+    char msg[96];
+    ksnprintf(msg, sizeof(msg), "Page fault at 0x%08X (error 0x%08X, eip 0x%08X)",
+              (uint32_t)addr, regs->err_code, regs->eip);
+    panic(msg);
+}
+
+// Take over ISR 14 (after the IDT is set up)
+void vma_init(void) {
+    boot_space.dir = vmm_current();
+    register_interrupt_handler(PAGE_FAULT, page_fault_handler);
+}
+
+mm_space_t* mm_space_current(void) {
+    return space;
+}
+
+// Copy-on-write clone of the current address space: the child gets the
+// same areas and break and shares every faulted-in page until one side
+// writes to it
+mm_space_t* mm_space_clone(void) {
+    mm_space_t *child = kmalloc(sizeof(mm_space_t));
+    if (child == NULL) {
+        return NULL;
+    }
+    memcpy(child, space, sizeof(mm_space_t));
+    child->dir = vmm_clone();
+    if (child->dir == NULL) {
+        kfree(child);
+        return NULL;
+    }
+    return child;
+}
+
+// Free a cloned address space; the current one and the boot space stay
+void mm_space_destroy(mm_space_t* s) {
+    if (s == NULL || s == space || s == &boot_space) {
+        return;
+    }
+    vmm_destroy(s->dir);
+    kfree(s);
+}
+
+void mm_space_switch(mm_space_t* s) {
+    space = s;
+    vmm_switch(s->dir);
+}
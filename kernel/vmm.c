@@ -0,0 +1,309 @@
+#include "../include/kernel.h"
+#include "../include/kernel/mm.h"
+#include "../include/kernel/cpu.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Two-level x86 paging.
+//
+// Physical memory is identity mapped from 0 up to the end of the frame
+// allocator's range. With PSE this costs one 4MB page directory entry per
+// 4MB and no page tables at all; the entries are global (when PGE is
+// present) so they survive CR3 reloads. Everything above the direct map is
+// mapped with ordinary 4KB pages through vmm_map_page().
+//
+// Every address space shares the kernel's page-directory entries; only the
+// user range has tables of its own. vmm_clone() shares those user pages
+// copy-on-write, so a fork copies page tables but no page contents.
+
+#define PDE_INDEX(v) ((uintptr_t)(v) >> 22)
+#define PTE_INDEX(v) (((uintptr_t)(v) >> 12) & 0x3FF)
+#define LARGE_PAGE_SIZE 0x400000
+#define ENTRY_ADDR(e) ((e) & ~(uint32_t)0xFFF)
+
+// Page-directory slots of the per-address-space user range
+#define USER_PDE_FIRST  PDE_INDEX(MM_USER_START)
+#define USER_PDE_END    PDE_INDEX(MM_USER_END)
+
+// End of the kernel image (linker.ld)
+extern uint8_t _kernel_end[];
+
+static uint32_t page_directory[1024] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t *current_directory = page_directory;
+static uintptr_t direct_map_end;
+static uint32_t global_flag;
+
+// Page table covering virt, allocated on demand if create is set
+static uint32_t* get_page_table(void* virt, bool create) {
+    uint32_t pde = current_directory[PDE_INDEX(virt)];
+
+    if (pde & VMM_PRESENT) {
+        // A 4MB page has no table to descend into
+        if (pde & VMM_LARGE) {
+            return NULL;
+        }
+        return (uint32_t*)ENTRY_ADDR(pde);
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    uint32_t *table = pfa_alloc_zeroed();
+    if (table == NULL) {
+        return NULL;
+    }
+    current_directory[PDE_INDEX(virt)] = (uint32_t)(uintptr_t)table | VMM_PRESENT | VMM_WRITE | VMM_USER;
+    return table;
+}
+
+// Build the direct map and turn paging on
+void vmm_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    bool pse = (edx & CPUID_EDX_PSE) != 0;
+    uint32_t cr4 = read_cr4();
+    if (pse) {
+        cr4 |= CR4_PSE;
+    }
+    if (edx & CPUID_EDX_PGE) {
+        cr4 |= CR4_PGE;
+        global_flag = VMM_GLOBAL;
+    }
+
+    // Cover the kernel image and every frame the allocator manages
+    direct_map_end = pfa_max_address();
+    if (direct_map_end < (uintptr_t)_kernel_end) {
+        direct_map_end = (uintptr_t)_kernel_end;
+    }
+    direct_map_end = (direct_map_end + LARGE_PAGE_SIZE - 1) & ~(uintptr_t)(LARGE_PAGE_SIZE - 1);
+
+    for (uintptr_t addr = 0; addr < direct_map_end; addr += LARGE_PAGE_SIZE) {
+        if (pse) {
+            page_directory[PDE_INDEX(addr)] = (uint32_t)addr | VMM_PRESENT | VMM_WRITE | VMM_LARGE | global_flag;
+            continue;
+        }
+
+        // No PSE: fall back to 4KB tables for the direct map
+        uint32_t *table = pfa_alloc();
+        if (table == NULL) {
+            direct_map_end = addr;
+            break;
+        }
+        for (uint32_t i = 0; i < 1024; i++) {
+            table[i] = (uint32_t)(addr + i * PAGE_SIZE) | VMM_PRESENT | VMM_WRITE | global_flag;
+        }
+        page_directory[PDE_INDEX(addr)] = (uint32_t)(uintptr_t)table | VMM_PRESENT | VMM_WRITE;
+    }
+
+    // Give the heap window all its tables now, so that page directories
+    // cloned later never miss a table the heap creates as it grows
+    for (uintptr_t addr = KERNEL_HEAP_START; addr < KERNEL_HEAP_START + (uintptr_t)KERNEL_HEAP_MAX; addr += LARGE_PAGE_SIZE) {
+        get_page_table((void*)addr, true);
+    }
+
+    write_cr4(cr4);
+    write_cr3((uint32_t)(uintptr_t)page_directory);
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+}
+
+// Map one 4KB page with explicit flags; returns virt, or NULL on failure
+void* vmm_map_page_flags(void* phys, void* virt, uint32_t flags) {
+    uint32_t *table = get_page_table(virt, true);
+    if (table == NULL) {
+        return NULL;
+    }
+
+    uint32_t old = table[PTE_INDEX(virt)];
+    table[PTE_INDEX(virt)] = ENTRY_ADDR((uint32_t)(uintptr_t)phys) | (flags & 0xFFF) | VMM_PRESENT;
+
+    // Only a previously valid translation can be cached in the TLB
+    if (old & VMM_PRESENT) {
+        invlpg(virt);
+    }
+    return virt;
+}
+
+// Map one kernel page read/write
+void* vmm_map_page(void* phys, void* virt) {
+    return vmm_map_page_flags(phys, virt, VMM_WRITE | global_flag);
+}
+
+// Remove a single 4KB mapping and flush just that TLB entry
+void vmm_unmap_page(void* virt) {
+    uint32_t *table = get_page_table(virt, false);
+    if (table == NULL) {
+        return;
+    }
+    table[PTE_INDEX(virt)] = 0;
+    invlpg(virt);
+}
+
+// Unmap [virt, virt + length) and give the frames behind it back to the
+// frame allocator. Page-directory slots without a table are skipped whole.
+void vmm_unmap_range(void* virt, size_t length) {
+    uintptr_t addr = (uintptr_t)virt & ~(uintptr_t)(PAGE_SIZE - 1);
+    uintptr_t end = (uintptr_t)virt + length;
+
+    while (addr < end) {
+        uint32_t *table = get_page_table((void*)addr, false);
+        if (table == NULL) {
+            addr = (addr + LARGE_PAGE_SIZE) & ~(uintptr_t)(LARGE_PAGE_SIZE - 1);
+            if (addr == 0) {
+                break;
+            }
+            continue;
+        }
+
+        uint32_t pte = table[PTE_INDEX(addr)];
+        if (pte & VMM_PRESENT) {
+            table[PTE_INDEX(addr)] = 0;
+            invlpg((void*)addr);
+            pfa_free((void*)(uintptr_t)ENTRY_ADDR(pte));
+        }
+        addr += PAGE_SIZE;
+    }
+}
+
+// Translate a virtual address, or return 0 if it is not mapped
+uintptr_t vmm_get_physical(void* virt) {
+    uint32_t pde = current_directory[PDE_INDEX(virt)];
+
+    if (!(pde & VMM_PRESENT)) {
+        return 0;
+    }
+    if (pde & VMM_LARGE) {
+        return (pde & ~(uint32_t)(LARGE_PAGE_SIZE - 1)) + ((uintptr_t)virt & (LARGE_PAGE_SIZE - 1));
+    }
+
+    uint32_t pte = ((uint32_t*)ENTRY_ADDR(pde))[PTE_INDEX(virt)];
+    if (!(pte & VMM_PRESENT)) {
+        return 0;
+    }
+    return ENTRY_ADDR(pte) + ((uintptr_t)virt & 0xFFF);
+}
+
+// Allocate a frame; it is reachable at its physical address through the
+// direct map, so no new mapping is needed
+void* vmm_alloc_page(void) {
+    return pfa_alloc();
+}
+
+void vmm_free_page(void* page) {
+    if ((uintptr_t)page < direct_map_end) {
+        pfa_free(page);
+    }
+}
+
+// Create a copy-on-write clone of the current address space. Writable user
+// pages become read-only + VMM_COW on both sides and every shared frame
+// gains a reference. Returns the new page directory, or NULL.
+uint32_t* vmm_clone(void) {
+    uint32_t *dir = pfa_alloc_zeroed();
+    if (dir == NULL) {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < 1024; i++) {
+        uint32_t pde = current_directory[i];
+        if (!(pde & VMM_PRESENT)) {
+            continue;
+        }
+        if (i < USER_PDE_FIRST || i >= USER_PDE_END) {
+            dir[i] = pde;
+            continue;
+        }
+
+        uint32_t *table = pfa_alloc_zeroed();
+        if (table == NULL) {
+            vmm_destroy(dir);
+            return NULL;
+        }
+        dir[i] = (uint32_t)(uintptr_t)table | (pde & 0xFFF);
+
+        uint32_t *src = (uint32_t*)ENTRY_ADDR(pde);
+        for (uint32_t j = 0; j < 1024; j++) {
+            uint32_t pte = src[j];
+            if (!(pte & VMM_PRESENT)) {
+                continue;
+            }
+            if (!pfa_ref((void*)(uintptr_t)ENTRY_ADDR(pte))) {
+                vmm_destroy(dir);
+                return NULL;
+            }
+            if (pte & VMM_WRITE) {
+                pte = (pte & ~(uint32_t)VMM_WRITE) | VMM_COW;
+                src[j] = pte;
+            }
+            table[j] = pte;
+        }
+    }
+
+    // The parent's user pages just lost their write permission
+    write_cr3(read_cr3());
+    return dir;
+}
+
+// Tear down an address space made by vmm_clone(); every user frame loses
+// one reference
+void vmm_destroy(uint32_t* dir) {
+    if (dir == NULL || dir == page_directory || dir == current_directory) {
+        return;
+    }
+
+    for (uint32_t i = USER_PDE_FIRST; i < USER_PDE_END; i++) {
+        if (!(dir[i] & VMM_PRESENT)) {
+            continue;
+        }
+        uint32_t *table = (uint32_t*)ENTRY_ADDR(dir[i]);
+        for (uint32_t j = 0; j < 1024; j++) {
+            if (table[j] & VMM_PRESENT) {
+                pfa_free((void*)(uintptr_t)ENTRY_ADDR(table[j]));
+            }
+        }
+        pfa_free(table);
+    }
+    pfa_free(dir);
+}
+
+// Make dir the active address space
+void vmm_switch(uint32_t* dir) {
+    current_directory = dir;
+    write_cr3((uint32_t)(uintptr_t)dir);
+}
+
+uint32_t* vmm_current(void) {
+    return current_directory;
+}
+
+// Resolve a write fault on a copy-on-write page: the last user of a frame
+// simply gets it back writable, anyone else gets a private copy
+bool vmm_handle_cow(void* virt) {
+    uint32_t *table = get_page_table(virt, false);
+    if (table == NULL) {
+        return false;
+    }
+
+    uint32_t pte = table[PTE_INDEX(virt)];
+    if (!(pte & VMM_PRESENT) || !(pte & VMM_COW)) {
+        return false;
+    }
+
+    void *frame = (void*)(uintptr_t)ENTRY_ADDR(pte);
+    if (pfa_refcount(frame) > 1) {
+        void *copy = pfa_alloc();
+        if (copy == NULL) {
+            return false;
+        }
+        // Both frames are reachable through the direct map
+        memcpy(copy, frame, PAGE_SIZE);
+        pfa_free(frame);
+        pte = (uint32_t)(uintptr_t)copy | (pte & 0xFFF);
+    }
+
+    table[PTE_INDEX(virt)] = (pte & ~(uint32_t)VMM_COW) | VMM_WRITE;
+    invlpg(virt);
+    return true;
+}
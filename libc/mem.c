@@ -1,21 +1,164 @@
 #include "mem.h"
+#include "word.h"
+#include <stdint.h>
+
+/*
+ * Each routine picks a strategy by size: short runs go byte by byte
+ * (aligning costs more than it saves), medium runs move aligned 32-bit
+ * words, long runs use the string instructions, and the longest go to
+ * the accelerated routines installed at boot, if any (saving the SIMD
+ * state first is only worth it for big blocks). The crossover points
+ * live in the tables below; tools/membench measures them.
+ *
+ * With SSE2, scans win from about 512 bytes. Copies break even with
+ * rep movsd only from about 64 KiB (the gain is in misaligned copies,
+ * which rep can't take), and fills only with streaming stores: below
+ * that, rep stosd is as fast.
+ */
+
+struct mem_limits {
+    size_t word_min;    /* From this size on, use the word loop */
+    size_t rep_min;     /* From this size on, use rep movsd/stosd */
+    size_t accel_min;   /* From this size on, try the accelerated routine */
+};
+
+static const struct mem_limits copy_limits = { 16, 256, 64 * 1024 };
+static const struct mem_limits set_limits  = { 16, 128, 1024 * 1024 };
+static const struct mem_limits scan_limits = { 16, 0, 512 };   /* No rep path */
+
+static const struct mem_accel* accel;
+
+void mem_set_accel(const struct mem_accel* ops) {
+    accel = ops;
+}
+
+/* Forward copy; also safe for overlapping regions with dest below src */
+static void copy_forward(unsigned char* d, const unsigned char* s, size_t num) {
+    if (num >= copy_limits.word_min) {
+        while ((uintptr_t)d & 3) {
+            *d++ = *s++;
+            num--;
+        }
+
+        size_t words = num >> 2;
+        num &= 3;
+        /* rep movsd is only fast when source and destination are aligned
+           alike; otherwise the word loop's misaligned loads win */
+        if (words >= copy_limits.rep_min / 4 && !(((uintptr_t)s) & 3)) {
+            __asm__ volatile ("rep movsl"
+                              : "+D"(d), "+S"(s), "+c"(words)
+                              :
+                              : "memory");
+        } else {
+            word_t* dw = (word_t*)d;
+            const uword_t* sw = (const uword_t*)s;
+            for (; words >= 4; words -= 4) {
+                uint32_t a = sw[0], b = sw[1], c = sw[2], e = sw[3];
+                dw[0] = a;
+                dw[1] = b;
+                dw[2] = c;
+                dw[3] = e;
+                dw += 4;
+                sw += 4;
+            }
+            while (words--) {
+                *dw++ = *sw++;
+            }
+            d = (unsigned char*)dw;
+            s = (const unsigned char*)sw;
+        }
+    }
+    while (num--) {
+        *d++ = *s++;
+    }
+}
+
+/* Backward copy for overlapping regions with dest above src */
+static void copy_backward(unsigned char* d, const unsigned char* s, size_t num) {
+    d += num;
+    s += num;
+    if (num >= copy_limits.word_min) {
+        while ((uintptr_t)d & 3) {
+            *--d = *--s;
+            num--;
+        }
+
+        size_t words = num >> 2;
+        num &= 3;
+        /* No rep variant here: with the direction flag set, movsd runs
+           without the fast-string microcode and loses to this loop */
+        word_t* dw = (word_t*)d;
+        const uword_t* sw = (const uword_t*)s;
+        for (; words >= 4; words -= 4) {
+            uint32_t a = sw[-1], b = sw[-2], c = sw[-3], e = sw[-4];
+            dw[-1] = a;
+            dw[-2] = b;
+            dw[-3] = c;
+            dw[-4] = e;
+            dw -= 4;
+            sw -= 4;
+        }
+        while (words--) {
+            *--dw = *--sw;
+        }
+        d = (unsigned char*)dw;
+        s = (const unsigned char*)sw;
+    }
+    while (num--) {
+        *--d = *--s;
+    }
+}
 
 /* Sets the first number bytes of ptr to value */
 void* memset(void* ptr, int value, size_t num) {
     unsigned char* p = (unsigned char*)ptr;
-    for (size_t i = 0; i < num; i++) {
-        p[i] = (unsigned char)value;
+    unsigned char byte = (unsigned char)value;
+
+    if (num >= set_limits.accel_min && accel != NULL && accel->set(ptr, value, num)) {
+        return ptr;
+    }
+    if (num >= set_limits.word_min) {
+        uint32_t pattern = byte * 0x01010101u;
+
+        while ((uintptr_t)p & 3) {
+            *p++ = byte;
+            num--;
+        }
+
+        size_t words = num >> 2;
+        num &= 3;
+        if (words >= set_limits.rep_min / 4) {
+            __asm__ volatile ("rep stosl"
+                              : "+D"(p), "+c"(words)
+                              : "a"(pattern)
+                              : "memory");
+        } else {
+            word_t* w = (word_t*)p;
+            for (; words >= 4; words -= 4) {
+                w[0] = pattern;
+                w[1] = pattern;
+                w[2] = pattern;
+                w[3] = pattern;
+                w += 4;
+            }
+            while (words--) {
+                *w++ = pattern;
+            }
+            p = (unsigned char*)w;
+        }
+    }
+    while (num--) {
+        *p++ = byte;
     }
     return ptr;
 }
 
 /* Copies num bytes from src to dest; no overlap safety */
 void* memcpy(void* dest, const void* src, size_t num) {
-    unsigned char* d = (unsigned char*)dest;
-    const unsigned char* s = (const unsigned char*)src;
-    for (size_t i = 0; i < num; i++) {
-        d[i] = s[i];
+    if (num >= copy_limits.accel_min && accel != NULL && accel->copy(dest, src, num)) {
+        return dest;
     }
+    copy_forward((unsigned char*)dest, (const unsigned char*)src, num);
     return dest;
 }
 
@@ -28,16 +171,16 @@ void* memmove(void* dest, const void* src, size_t num) {
         return dest;
     }
 
+    if (d + num <= s || d >= s + num) {
+        // Disjoint, so memcpy() may take its fastest path
+        return memcpy(dest, src, num);
+    }
     if (d < s) {
         // Safe to copy forward ....(vsauce music)
-        for (size_t i = 0; i < num; i++) {
-            d[i] = s[i];
-        }
+        copy_forward(d, s, num);
     } else {
         // Copy backwards to avoid overwrite
-        for (size_t i = num; i > 0; i--) {
-            d[i - 1] = s[i - 1];
-        }
+        copy_backward(d, s, num);
     }
     return dest;
 }
@@ -46,6 +189,27 @@ void* memmove(void* dest, const void* src, size_t num) {
 int memcmp(const void* ptr1, const void* ptr2, size_t num) {
     const unsigned char* p1 = (const unsigned char*)ptr1;
     const unsigned char* p2 = (const unsigned char*)ptr2;
+    int result;
+
+    if (num >= scan_limits.accel_min && accel != NULL && accel->compare(ptr1, ptr2, num, &result)) {
+        return result;
+    }
+    if (num >= scan_limits.word_min) {
+        // Skip equal words; the byte loop below finds the first difference
+        while ((uintptr_t)p1 & 3) {
+            if (*p1 != *p2) {
+                return (int)*p1 - (int)*p2;
+            }
+            p1++;
+            p2++;
+            num--;
+        }
+        while (num >= 4 && *(const word_t*)p1 == *(const uword_t*)p2) {
+            p1 += 4;
+            p2 += 4;
+            num -= 4;
+        }
+    }
     for (size_t i = 0; i < num; i++) {
         if (p1[i] != p2[i]) {
             return (int)p1[i] - (int)p2[i];
@@ -58,6 +222,25 @@ int memcmp(const void* ptr1, const void* ptr2, size_t num) {
 void* memchr(const void* ptr, int value, size_t num) {
     const unsigned char* p = (const unsigned char*)ptr;
     unsigned char val = (unsigned char)value;
+    void* found;
+
+    if (num >= scan_limits.accel_min && accel != NULL && accel->find(ptr, value, num, &found)) {
+        return found;
+    }
+    if (num >= scan_limits.word_min) {
+        // Skip words without the byte; the loop below pins it down
+        while ((uintptr_t)p & 3) {
+            if (*p == val) {
+                return (void*)p;
+            }
+            p++;
+            num--;
+        }
+        while (num >= 4 && !word_has_byte(*(const word_t*)p, val)) {
+            p += 4;
+            num -= 4;
+        }
+    }
     for (size_t i = 0; i < num; i++) {
         if (p[i] == val) {
             return (void*)(p + i);
@@ -2,6 +2,7 @@
 #define MEM_H
 
 #include <stddef.h>
+#include <stdbool.h>
 
 /* Sets the first num bytes of ptr to the specified value */
 void* memset(void* ptr, int value, size_t num);
@@ -20,5 +21,20 @@ int memcmp(const void* ptr1, const void* ptr2, size_t num);
    Returns pointer to first occurrence or NULL if not found */
 void* memchr(const void* ptr, int value, size_t num);
 
+/* Accelerated versions of the routines above for large blocks, installed
+   at boot once the CPU is known to support them. Each returns false when
+   it cannot run right now (inside an interrupt handler, say) and the
+   caller falls back to the scalar code. copy is only used for regions
+   that don't overlap. */
+struct mem_accel {
+    bool (*copy)(void* dest, const void* src, size_t num);
+    bool (*set)(void* ptr, int value, size_t num);
+    bool (*compare)(const void* ptr1, const void* ptr2, size_t num, int* result);
+    bool (*find)(const void* ptr, int value, size_t num, void** result);
+};
+
+/* Route large blocks through accel (NULL = scalar only) */
+void mem_set_accel(const struct mem_accel* accel);
+
 #endif
 // im tired man
\ No newline at end of file
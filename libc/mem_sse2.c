@@ -0,0 +1,215 @@
+#include "mem_sse2.h"
+#include <stdint.h>
+
+/*
+ * Blocks are moved 64 bytes per iteration with unaligned loads and
+ * aligned stores. The ragged ends are covered by one unaligned 16-byte
+ * access each, overlapping the aligned body where needed, so no byte
+ * loop runs unless the whole block is shorter than 16 bytes.
+ *
+ * This file must be compiled without compiler-generated SSE (the kernel
+ * and host builds both pass -mgeneral-regs-only). The asm below therefore
+ * owns every XMM register: none are listed as clobbered, and the
+ * broadcast patterns stay live across separate asm statements.
+ */
+
+/* From this size on, stores bypass the cache with movntdq: a block that
+   large would evict everything else and is rarely read back soon */
+#define SSE2_NT_MIN (1024 * 1024)
+
+/* 16 bytes at p, for telling the compiler what an asm block reads */
+#define BLOCK16(p) (*(const unsigned char (*)[16])(p))
+
+static inline void copy16(unsigned char* d, const unsigned char* s) {
+    __asm__ volatile ("movdqu (%1), %%xmm0\n\t"
+                      "movdqu %%xmm0, (%0)"
+                      :
+                      : "r"(d), "r"(s), "m"(BLOCK16(s))
+                      : "memory");
+}
+
+void mem_sse2_copy(void* dest, const void* src, size_t num) {
+    unsigned char* d = (unsigned char*)dest;
+    const unsigned char* s = (const unsigned char*)src;
+
+    if (num < 16) {
+        while (num--) {
+            *d++ = *s++;
+        }
+        return;
+    }
+
+    /* Last 16 bytes first, then align the destination */
+    copy16(d + num - 16, s + num - 16);
+    size_t head = -(uintptr_t)d & 15;
+    copy16(d, s);
+    d += head;
+    s += head;
+    num -= head;
+
+    size_t blocks = num / 64;
+    if (blocks != 0 && num >= SSE2_NT_MIN) {
+        __asm__ volatile ("1:\n\t"
+                          "movdqu   (%1), %%xmm0\n\t"
+                          "movdqu 16(%1), %%xmm1\n\t"
+                          "movdqu 32(%1), %%xmm2\n\t"
+                          "movdqu 48(%1), %%xmm3\n\t"
+                          "movntdq %%xmm0,   (%0)\n\t"
+                          "movntdq %%xmm1, 16(%0)\n\t"
+                          "movntdq %%xmm2, 32(%0)\n\t"
+                          "movntdq %%xmm3, 48(%0)\n\t"
+                          "add $64, %1\n\t"
+                          "add $64, %0\n\t"
+                          "dec %2\n\t"
+                          "jnz 1b\n\t"
+                          "sfence"
+                          : "+r"(d), "+r"(s), "+r"(blocks)
+                          :
+                          : "memory");
+    } else if (blocks != 0) {
+        __asm__ volatile ("1:\n\t"
+                          "movdqu   (%1), %%xmm0\n\t"
+                          "movdqu 16(%1), %%xmm1\n\t"
+                          "movdqu 32(%1), %%xmm2\n\t"
+                          "movdqu 48(%1), %%xmm3\n\t"
+                          "movdqa %%xmm0,   (%0)\n\t"
+                          "movdqa %%xmm1, 16(%0)\n\t"
+                          "movdqa %%xmm2, 32(%0)\n\t"
+                          "movdqa %%xmm3, 48(%0)\n\t"
+                          "add $64, %1\n\t"
+                          "add $64, %0\n\t"
+                          "dec %2\n\t"
+                          "jnz 1b"
+                          : "+r"(d), "+r"(s), "+r"(blocks)
+                          :
+                          : "memory");
+    }
+
+    /* Up to three more whole chunks; the last partial one was done above */
+    for (num &= 63; num >= 16; num -= 16) {
+        copy16(d, s);
+        d += 16;
+        s += 16;
+    }
+}
+
+void mem_sse2_set(void* ptr, int value, size_t num) {
+    unsigned char* p = (unsigned char*)ptr;
+    uint32_t pattern = (unsigned char)value * 0x01010101u;
+
+    if (num < 16) {
+        while (num--) {
+            *p++ = (unsigned char)value;
+        }
+        return;
+    }
+
+    __asm__ volatile ("movd %0, %%xmm0\n\t"
+                      "pshufd $0, %%xmm0, %%xmm0"
+                      :
+                      : "r"(pattern));
+
+    __asm__ volatile ("movdqu %%xmm0, (%0)\n\t"
+                      "movdqu %%xmm0, -16(%0,%1)"
+                      :
+                      : "r"(p), "r"(num)
+                      : "memory");
+    size_t head = -(uintptr_t)p & 15;
+    p += head;
+    num -= head;
+
+    size_t blocks = num / 64;
+    if (blocks != 0 && num >= SSE2_NT_MIN) {
+        __asm__ volatile ("1:\n\t"
+                          "movntdq %%xmm0,   (%0)\n\t"
+                          "movntdq %%xmm0, 16(%0)\n\t"
+                          "movntdq %%xmm0, 32(%0)\n\t"
+                          "movntdq %%xmm0, 48(%0)\n\t"
+                          "add $64, %0\n\t"
+                          "dec %1\n\t"
+                          "jnz 1b\n\t"
+                          "sfence"
+                          : "+r"(p), "+r"(blocks)
+                          :
+                          : "memory");
+    } else if (blocks != 0) {
+        __asm__ volatile ("1:\n\t"
+                          "movdqa %%xmm0,   (%0)\n\t"
+                          "movdqa %%xmm0, 16(%0)\n\t"
+                          "movdqa %%xmm0, 32(%0)\n\t"
+                          "movdqa %%xmm0, 48(%0)\n\t"
+                          "add $64, %0\n\t"
+                          "dec %1\n\t"
+                          "jnz 1b"
+                          : "+r"(p), "+r"(blocks)
+                          :
+                          : "memory");
+    }
+    for (num &= 63; num >= 16; num -= 16) {
+        __asm__ volatile ("movdqa %%xmm0, (%0)" : : "r"(p) : "memory");
+        p += 16;
+    }
+}
+
+/* Bit i set when byte i of the 16 at a equals byte i of the 16 at b */
+static inline unsigned equal_mask(const unsigned char* a, const unsigned char* b) {
+    unsigned mask;
+    __asm__ ("movdqu (%1), %%xmm0\n\t"
+             "movdqu (%2), %%xmm1\n\t"
+             "pcmpeqb %%xmm1, %%xmm0\n\t"
+             "pmovmskb %%xmm0, %0"
+             : "=r"(mask)
+             : "r"(a), "r"(b), "m"(BLOCK16(a)), "m"(BLOCK16(b)));
+    return mask;
+}
+
+int mem_sse2_compare(const void* ptr1, const void* ptr2, size_t num) {
+    const unsigned char* p1 = (const unsigned char*)ptr1;
+    const unsigned char* p2 = (const unsigned char*)ptr2;
+
+    for (; num >= 16; num -= 16) {
+        unsigned mask = equal_mask(p1, p2);
+        if (mask != 0xFFFF) {
+            unsigned i = __builtin_ctz(~mask);
+            return (int)p1[i] - (int)p2[i];
+        }
+        p1 += 16;
+        p2 += 16;
+    }
+    for (size_t i = 0; i < num; i++) {
+        if (p1[i] != p2[i]) {
+            return (int)p1[i] - (int)p2[i];
+        }
+    }
+    return 0;
+}
+
+void* mem_sse2_find(const void* ptr, int value, size_t num) {
+    const unsigned char* p = (const unsigned char*)ptr;
+    unsigned char val = (unsigned char)value;
+    uint32_t pattern = val * 0x01010101u;
+
+    __asm__ volatile ("movd %0, %%xmm1\n\t"
+                      "pshufd $0, %%xmm1, %%xmm1"
+                      :
+                      : "r"(pattern));
+
+    for (; num >= 16; num -= 16) {
+        unsigned mask;
+        __asm__ volatile ("movdqu (%1), %%xmm0\n\t"
+                          "pcmpeqb %%xmm1, %%xmm0\n\t"
+                          "pmovmskb %%xmm0, %0"
+                          : "=r"(mask)
+                          : "r"(p), "m"(BLOCK16(p)));
+        if (mask != 0) {
+            return (void*)(p + __builtin_ctz(mask));
+        }
+        p += 16;
+    }
+    for (size_t i = 0; i < num; i++) {
+        if (p[i] == val) {
+            return (void*)(p + i);
+        }
+    }
+    return NULL;
+}
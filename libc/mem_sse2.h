@@ -0,0 +1,21 @@
+#ifndef MEM_SSE2_H
+#define MEM_SSE2_H
+
+#include <stddef.h>
+
+/* SSE2 block routines. They use XMM registers freely: the caller must own
+   the SSE state (see kernel/simd.c) and have SSE enabled in CR4. */
+
+/* Copies num bytes; regions must not overlap */
+void mem_sse2_copy(void* dest, const void* src, size_t num);
+
+/* Sets num bytes of ptr to value */
+void mem_sse2_set(void* ptr, int value, size_t num);
+
+/* Same result as memcmp */
+int mem_sse2_compare(const void* ptr1, const void* ptr2, size_t num);
+
+/* Same result as memchr */
+void* mem_sse2_find(const void* ptr, int value, size_t num);
+
+#endif
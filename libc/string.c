@@ -1,31 +1,122 @@
 #include "string.h"
+#include "word.h"
+
+/*
+ * strlen, strcmp and strncmp look at a whole word per step once their
+ * pointer is aligned. Aligned words never straddle a page, so reading
+ * past the terminator within the last word can't fault even when the
+ * string ends right before an unmapped page.
+ */
 
 /* Returns length of null-terminated string */
 size_t strlen(const char* str) {
-    size_t len = 0;
-    while (str[len]) {
-        len++;
+    const char* p = str;
+
+    while ((uintptr_t)p & 3) {
+        if (*p == '\0') {
+            return (size_t)(p - str);
+        }
+        p++;
+    }
+    while (!word_has_zero(*(const word_t*)p)) {
+        p += 4;
+    }
+    while (*p) {
+        p++;
+    }
+    return (size_t)(p - str);
+}
+
+/*
+ * Number of leading words (up to max) that are equal in a and b and hold
+ * no terminator; a must be aligned. When b isn't, its words are spliced
+ * from two aligned reads, and the next one is only read once the current
+ * one is known to hold no terminator.
+ */
+static size_t equal_words(const unsigned char* a, const unsigned char* b, size_t max) {
+    unsigned shift = ((uintptr_t)b & 3) * 8;
+    size_t words = 0;
+
+    if (max == 0) {
+        return 0;
+    }
+    if (shift == 0) {
+        while (words < max) {
+            uint32_t wa = ((const word_t*)a)[words];
+            if (wa != ((const word_t*)b)[words] || word_has_zero(wa)) {
+                break;
+            }
+            words++;
+        }
+        return words;
+    }
+
+    const word_t* bw = (const word_t*)(b - shift / 8);
+    uint32_t lo = *bw++;
+    while (words < max) {
+        // Bytes of lo before b are padded with 0xFF so they can't match
+        if (word_has_zero((lo >> shift) | (~0u << (32 - shift)))) {
+            break;
+        }
+        uint32_t hi = *bw++;
+        uint32_t wa = ((const word_t*)a)[words];
+        if (wa != ((lo >> shift) | (hi << (32 - shift))) || word_has_zero(wa)) {
+            break;
+        }
+        lo = hi;
+        words++;
     }
-    return len;
+    return words;
 }
 
 /* Compares two strings (null-terminated), returns 0 if equal */
 int strcmp(const char* s1, const char* s2) {
-    while (*s1 && (*s1 == *s2)) {
-        s1++;
-        s2++;
+    const unsigned char* a = (const unsigned char*)s1;
+    const unsigned char* b = (const unsigned char*)s2;
+
+    while ((uintptr_t)a & 3) {
+        if (*a == '\0' || *a != *b) {
+            return *a - *b;
+        }
+        a++;
+        b++;
     }
-    return (unsigned char)*s1 - (unsigned char)*s2;
+
+    size_t skip = equal_words(a, b, SIZE_MAX / 4) * 4;
+    a += skip;
+    b += skip;
+    while (*a && (*a == *b)) {
+        a++;
+        b++;
+    }
+    return *a - *b;
 }
 
 /* Compares up to n characters of two strings */
 int strncmp(const char* s1, const char* s2, size_t n) {
-    size_t i = 0;
-    while (i < n && s1[i] && (s1[i] == s2[i])) {
-        i++;
+    const unsigned char* a = (const unsigned char*)s1;
+    const unsigned char* b = (const unsigned char*)s2;
+
+    while (n > 0 && ((uintptr_t)a & 3)) {
+        if (*a == '\0' || *a != *b) {
+            return *a - *b;
+        }
+        a++;
+        b++;
+        n--;
     }
-    if (i == n) return 0;
-    return (unsigned char)s1[i] - (unsigned char)s2[i];
+
+    size_t skip = equal_words(a, b, n / 4) * 4;
+    a += skip;
+    b += skip;
+    n -= skip;
+    while (n > 0 && *a && (*a == *b)) {
+        a++;
+        b++;
+        n--;
+    }
+    if (n == 0) return 0;
+    return *a - *b;
 }
 
 /* Copies null-terminated string src to dest */
@@ -47,15 +138,6 @@ char* strncpy(char* dest, const char* src, size_t n) {
     return dest;
 }
 
-/* Sets the first n bytes of the memory area pointed to by s to the specified value */
-void* memset(void* s, int c, size_t n) {
-    unsigned char* p = (unsigned char*)s;
-    for (size_t i = 0; i < n; i++) {
-        p[i] = (unsigned char)c;
-    }
-    return s;
-}
-
 /* Converts a decimal string to an integer */
 int atoi(const char* str) {
     int result = 0;
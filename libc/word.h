@@ -0,0 +1,27 @@
+#ifndef WORD_H
+#define WORD_H
+
+#include <stdint.h>
+
+/* Helpers for the word-at-a-time loops in mem.c and string.c */
+
+/* Word access to memory of any type; the unaligned variant is for the
+   side we don't align (x86 handles the misaligned loads in hardware) */
+typedef uint32_t __attribute__((__may_alias__)) word_t;
+typedef uint32_t __attribute__((__may_alias__, __aligned__(1))) uword_t;
+
+#define WORD_ONES  0x01010101u
+#define WORD_HIGHS 0x80808080u
+
+/* Non-zero when some byte of w is zero. Exact as a yes/no answer; which
+   byte it flags is only reliable for the lowest zero byte. */
+static inline uint32_t word_has_zero(uint32_t w) {
+    return (w - WORD_ONES) & ~w & WORD_HIGHS;
+}
+
+/* Non-zero when some byte of w equals c */
+static inline uint32_t word_has_byte(uint32_t w, unsigned char c) {
+    return word_has_zero(w ^ (c * WORD_ONES));
+}
+
+#endif
@@ -4,22 +4,20 @@
 #include "../include/string.h"
 #include "../include/types.h"
 
-void shell_parse_and_execute(const char *input) {
-    // Only support single-word commands and one argument
-    char cmd[32] = {0};
-    char arg[96] = {0};
-    size_t i = 0, j = 0;
-    while (input[i] && input[i] != ' ' && i < 31) {
-        cmd[i] = input[i];
-        i++;
+void shell_parse_and_execute(arena_t *arena, const char *input) {
+    // Only support single-word commands and one argument. Both are copied
+    // into the command's arena, which the caller resets afterwards.
+    size_t cmd_len = 0;
+    while (input[cmd_len] && input[cmd_len] != ' ') {
+        cmd_len++;
     }
-    cmd[i] = 0;
-    if (input[i] == ' ') {
-        i++;
-        while (input[i] && j < 95) {
-            arg[j++] = input[i++];
-        }
-        arg[j] = 0;
+    const char *rest = input[cmd_len] == ' ' ? input + cmd_len + 1 : "";
+
+    char *cmd = arena_strndup(arena, input, cmd_len);
+    char *arg = arena_strndup(arena, rest, strlen(rest));
+    if (cmd == NULL || arg == NULL) {
+        kprint("Out of memory\n");
+        return;
     }
     bin_execute(cmd, arg);
 }
@@ -1,6 +1,8 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-void shell_parse_and_execute(const char *input);
+#include "../include/kernel/arena.h"
+
+void shell_parse_and_execute(arena_t *arena, const char *input);
 
 #endif
@@ -11,11 +11,16 @@ static char history[MAX_HISTORY][INPUT_BUF];
 static int32_t history_count = 0;
 static int32_t history_pos = -1;
 static int32_t cursor_pos = 0;
+static arena_t *command_arena;  // Scratch memory for the running command
+
+// Console control sequences (understood by vga.c and serial terminals)
+#define ANSI_ERASE_LINE   "\x1b[K"     // From the cursor to the end of the line
+#define ANSI_INSERT_CHAR  "\x1b[@"     // Open a blank at the cursor
+#define ANSI_DELETE_CHAR  "\x1b[P"     // Close up the cell at the cursor
+#define ANSI_CURSOR_RIGHT "\x1b[C"
 
 static void clear_line() {
-    kprint("\r");
-    for (int32_t i = 0; i < 80; i++) kprint(" ");
-    kprint("\r");
+    kprint("\r" ANSI_ERASE_LINE);
 }
 
 void shell_add_to_history(const char *cmd) {
@@ -46,6 +51,7 @@ void shell_init() {
     for (int32_t i = 0; i < MAX_HISTORY; i++) {
         history[i][0] = '\0';
     }
+    command_arena = arena_create(0);
 }
 
 int shell_readline(char *buf, int maxlen);
@@ -53,9 +59,10 @@ int shell_readline(char *buf, int maxlen);
 void shell_run() {
     kprint("$ ");
     int len = shell_readline(input, INPUT_BUF);
-    if (len > 0) {
+    if (len > 0 && command_arena != NULL) {
         shell_add_to_history(input);
-        shell_parse_and_execute(input);
+        shell_parse_and_execute(command_arena, input);
+        arena_reset(command_arena);
     }
 }
 
@@ -93,7 +100,7 @@ void handle_arrow_keys(unsigned char scancode, char *buf, int *pos, int maxlen)
         }
     } else if (scancode == 0x4D) { // Right arrow
         if (*pos < (int)strlen(buf)) {
-            kprint(&buf[*pos]);
+            kprint(ANSI_CURSOR_RIGHT);
             (*pos)++;
         }
     }
@@ -149,12 +156,8 @@ int shell_readline(char *buf, int maxlen) {
                     }
                     i--;
                     cursor_pos--;
-                    clear_line();
-                    kprint("$ ");
-                    kprint(buf);
-                    for (int j = cursor_pos; j < i; j++) {
-                        kprint("\b");
-                    }
+                    // Step back and close the gap; the rest of the line moves
+                    kprint("\b" ANSI_DELETE_CHAR);
                 }
             } else if (c >= 32 && c < 127) {
                 if (i < maxlen - 1) {
@@ -163,12 +166,12 @@ int shell_readline(char *buf, int maxlen) {
                     }
                     buf[cursor_pos] = c;
                     i++;
+                    buf[i] = '\0';
                     cursor_pos++;
-                    clear_line();
-                    kprint("$ ");
-                    kprint(buf);
-                    for (int j = cursor_pos; j < i; j++) {
-                        kprint("\b");
+                    if (cursor_pos == i) {
+                        kprintf("%c", c);
+                    } else {
+                        kprintf(ANSI_INSERT_CHAR "%c", c);
                     }
                 }
             }
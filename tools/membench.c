@@ -0,0 +1,504 @@
+#include "../libc/mem.h"
+#include "../libc/mem_sse2.h"
+#include "../libc/string.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+// Throughput of the kernel's memory routines (libc/mem.c) in bytes per
+// cycle, for sizes from 1 B to 1 MiB, and of its string routines
+// (libc/string.c) for strings up to 4 KiB. The build renames the kernel
+// versions (memcpy -> kmem_memcpy, strlen -> kstr_strlen and so on) so
+// they don't collide with the host C library; this file sees them under
+// their usual names. Everything is checked against byte-wise reference
+// versions first.
+//
+// Usage: membench [-s] [-i iterations-scale]
+//
+//   -s   install the SSE2 routines (libc/mem_sse2.c) for large blocks, the
+//        way the kernel does at boot on SSE2 machines
+//
+// Columns:
+//   memcpy     aligned source and destination
+//   memcpy+1   source one byte off alignment
+//   memmove<   overlapping regions, dest above src (backward copy)
+//   memset     aligned destination
+//   memcmp     equal buffers (worst case: every byte is compared)
+//   memchr     byte not present (worst case: every byte is scanned)
+//   bytecopy   the plain byte loop the routines replaced, for reference
+//
+// String columns (equal strings, so every byte is examined):
+//   strlen     aligned string
+//   strcmp     both strings aligned
+//   strcmp+1   second string one byte off alignment
+//   strncmp    both strings aligned, limit past the end
+//   ref-*      the byte loops the routines replaced
+
+#define MAX_SIZE    (1024 * 1024)
+#define MAX_STRING  4096
+#define REPEATS     5
+
+static unsigned char *buf_a;
+static unsigned char *buf_b;
+
+// The byte-at-a-time loop the old memcpy used; kept out of line and
+// unvectorised so it measures what the kernel used to run
+__attribute__((noinline, optimize("no-tree-vectorize")))
+static void byte_copy(unsigned char *d, const unsigned char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        d[i] = s[i];
+    }
+}
+
+typedef void (*bench_fn)(size_t size);
+
+static void run_memcpy(size_t size) {
+    memcpy(buf_a, buf_b, size);
+}
+
+static void run_memcpy_unaligned(size_t size) {
+    memcpy(buf_a, buf_b + 1, size);
+}
+
+static void run_memmove_back(size_t size) {
+    memmove(buf_a + 8, buf_a, size);
+}
+
+static void run_memset(size_t size) {
+    memset(buf_a, (int)size, size);
+}
+
+static volatile int cmp_sink;
+
+static void run_memcmp(size_t size) {
+    cmp_sink = memcmp(buf_a, buf_b, size);
+}
+
+static volatile void *chr_sink;
+
+static void run_memchr(size_t size) {
+    chr_sink = memchr(buf_a, 0xFF, size);
+}
+
+static void run_bytecopy(size_t size) {
+    byte_copy(buf_a, buf_b, size);
+}
+
+static const struct {
+    const char *name;
+    bench_fn fn;
+} benches[] = {
+    { "memcpy",   run_memcpy },
+    { "memcpy+1", run_memcpy_unaligned },
+    { "memmove<", run_memmove_back },
+    { "memset",   run_memset },
+    { "memcmp",   run_memcmp },
+    { "memchr",   run_memchr },
+    { "bytecopy", run_bytecopy },
+};
+
+#define BENCH_COUNT (sizeof(benches) / sizeof(benches[0]))
+
+// The byte loops string.c used to have, as references
+__attribute__((noinline, optimize("no-tree-vectorize")))
+static size_t ref_strlen(const char *str) {
+    size_t len = 0;
+    while (str[len]) {
+        len++;
+    }
+    return len;
+}
+
+__attribute__((noinline, optimize("no-tree-vectorize")))
+static int ref_strcmp(const char *s1, const char *s2) {
+    while (*s1 && (*s1 == *s2)) {
+        s1++;
+        s2++;
+    }
+    return (unsigned char)*s1 - (unsigned char)*s2;
+}
+
+__attribute__((noinline, optimize("no-tree-vectorize")))
+static int ref_strncmp(const char *s1, const char *s2, size_t n) {
+    size_t i = 0;
+    while (i < n && s1[i] && (s1[i] == s2[i])) {
+        i++;
+    }
+    if (i == n) return 0;
+    return (unsigned char)s1[i] - (unsigned char)s2[i];
+}
+
+// Strings for the string benchmarks: all three hold the same characters,
+// terminated after the measured length. str_c is one byte off alignment.
+static char *str_a;
+static char *str_b;
+static char *str_c;
+static volatile size_t len_sink;
+
+static void run_strlen(size_t size) {
+    (void)size;
+    len_sink = strlen(str_a);
+}
+
+static void run_ref_strlen(size_t size) {
+    (void)size;
+    len_sink = ref_strlen(str_a);
+}
+
+static void run_strcmp(size_t size) {
+    (void)size;
+    cmp_sink = strcmp(str_a, str_b);
+}
+
+static void run_strcmp_unaligned(size_t size) {
+    (void)size;
+    cmp_sink = strcmp(str_a, str_c);
+}
+
+static void run_ref_strcmp(size_t size) {
+    (void)size;
+    cmp_sink = ref_strcmp(str_a, str_b);
+}
+
+static void run_strncmp(size_t size) {
+    cmp_sink = strncmp(str_a, str_b, size + 1);
+}
+
+static void run_ref_strncmp(size_t size) {
+    cmp_sink = ref_strncmp(str_a, str_b, size + 1);
+}
+
+static const struct {
+    const char *name;
+    bench_fn fn;
+} str_benches[] = {
+    { "strlen",     run_strlen },
+    { "ref-strlen", run_ref_strlen },
+    { "strcmp",     run_strcmp },
+    { "strcmp+1",   run_strcmp_unaligned },
+    { "ref-strcmp", run_ref_strcmp },
+    { "strncmp",    run_strncmp },
+    { "ref-strncmp", run_ref_strncmp },
+};
+
+#define STR_BENCH_COUNT (sizeof(str_benches) / sizeof(str_benches[0]))
+
+// Make the three strings len characters long
+static void set_strings(size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        str_a[i] = str_b[i] = str_c[i] = (char)('a' + i % 26);
+    }
+    str_a[len] = str_b[len] = str_c[len] = '\0';
+}
+
+// Best-of-REPEATS bytes per cycle for one routine at one size
+static double measure(bench_fn fn, size_t size, unsigned long iters) {
+    uint64_t best = UINT64_MAX;
+
+    for (int r = 0; r < REPEATS; r++) {
+        uint64_t start = __rdtsc();
+        for (unsigned long i = 0; i < iters; i++) {
+            fn(size);
+        }
+        uint64_t cycles = __rdtsc() - start;
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    return (double)size * iters / (double)best;
+}
+
+// Same shape as the kernel's wrappers in kernel/simd.c, state save
+// included, so the crossover sizes measured here carry over
+static unsigned char fx_area[512] __attribute__((aligned(16)));
+
+static void host_simd_begin(void) {
+    __asm__ volatile("fxsave (%0)" : : "r"(fx_area) : "memory");
+}
+
+static void host_simd_end(void) {
+    __asm__ volatile("fxrstor (%0)" : : "r"(fx_area) : "memory");
+}
+
+static bool host_copy(void *dest, const void *src, size_t num) {
+    host_simd_begin();
+    mem_sse2_copy(dest, src, num);
+    host_simd_end();
+    return true;
+}
+
+static bool host_set(void *ptr, int value, size_t num) {
+    host_simd_begin();
+    mem_sse2_set(ptr, value, num);
+    host_simd_end();
+    return true;
+}
+
+static bool host_compare(const void *ptr1, const void *ptr2, size_t num, int *result) {
+    host_simd_begin();
+    *result = mem_sse2_compare(ptr1, ptr2, num);
+    host_simd_end();
+    return true;
+}
+
+static bool host_find(const void *ptr, int value, size_t num, void **result) {
+    host_simd_begin();
+    *result = mem_sse2_find(ptr, value, num);
+    host_simd_end();
+    return true;
+}
+
+static const struct mem_accel host_sse2 = {
+    .copy = host_copy,
+    .set = host_set,
+    .compare = host_compare,
+    .find = host_find,
+};
+
+#define CHECK_MAX   (72 * 1024)
+
+// Check one size and pair of alignments against byte-wise references;
+// only the bytes up to limit can have been touched
+static int check_size(unsigned char *ref, unsigned char *out, size_t n, size_t off_d, size_t off_s) {
+    size_t limit = n + 64;
+
+    byte_copy(out, ref, limit);
+    memcpy(out + off_d, ref + 40 + off_s, n);
+    for (size_t i = 0; i < limit; i++) {
+        unsigned char want = (i >= off_d && i < off_d + n) ? ref[40 + off_s + i - off_d] : ref[i];
+        if (out[i] != want) {
+            printf("memcpy mismatch: n=%zu dst+%zu src+%zu at %zu\n", n, off_d, off_s, i);
+            return 0;
+        }
+    }
+
+    // Overlapping moves in both directions
+    for (int dir = 0; dir < 2; dir++) {
+        size_t from = dir ? 20 + off_s : 20 + off_d + 9;
+        size_t to = dir ? 20 + off_d + 9 : 20 + off_s;
+        byte_copy(out, ref, limit);
+        memmove(out + to, out + from, n);
+        for (size_t i = 0; i < limit; i++) {
+            unsigned char want = (i >= to && i < to + n) ? ref[from + i - to] : ref[i];
+            if (out[i] != want) {
+                printf("memmove mismatch: n=%zu from %zu to %zu at %zu\n", n, from, to, i);
+                return 0;
+            }
+        }
+    }
+
+    byte_copy(out, ref, limit);
+    memset(out + off_d, 0xA5, n);
+    for (size_t i = 0; i < limit; i++) {
+        unsigned char want = (i >= off_d && i < off_d + n) ? 0xA5 : ref[i];
+        if (out[i] != want) {
+            printf("memset mismatch: n=%zu dst+%zu at %zu\n", n, off_d, i);
+            return 0;
+        }
+    }
+
+    byte_copy(out, ref + off_s, n);
+    if (n > 0) {
+        size_t at = n - 1 - n / 3;
+        out[at] ^= 0x80;
+        int r = memcmp(out, ref + off_s, n);
+        if (r == 0 || (r > 0) != (out[at] > ref[off_s + at])) {
+            printf("memcmp missed a difference: n=%zu src+%zu at %zu\n", n, off_s, at);
+            return 0;
+        }
+        out[at] ^= 0x80;
+    }
+    if (memcmp(out, ref + off_s, n) != 0) {
+        printf("memcmp reported a difference in equal buffers: n=%zu\n", n);
+        return 0;
+    }
+
+    // A lone marker byte near the end, then no marker at all
+    for (size_t i = 0; i < n + off_s; i++) {
+        out[i] = 0;
+    }
+    if (n > 0) {
+        out[off_s + n - 1] = 0xEE;
+        if (memchr(out + off_s, 0xEE, n) != out + off_s + n - 1) {
+            printf("memchr missed the byte: n=%zu src+%zu\n", n, off_s);
+            return 0;
+        }
+        out[off_s + n - 1] = 0;
+    }
+    if (memchr(out + off_s, 0xEE, n) != NULL) {
+        printf("memchr found a byte that isn't there: n=%zu\n", n);
+        return 0;
+    }
+    return 1;
+}
+
+static int sign(int v) {
+    return (v > 0) - (v < 0);
+}
+
+// Fill len characters ending right before end, terminator included, and
+// return the start
+static char *string_before(char *end, size_t len, size_t diff_at) {
+    char *str = end - 1 - len;
+    for (size_t i = 0; i < len; i++) {
+        str[i] = (char)('a' + i % 26);
+    }
+    if (diff_at < len) {
+        str[diff_at] = 'A';
+    }
+    str[len] = '\0';
+    return str;
+}
+
+// String routines against the references for all short lengths, with
+// every string ending right before an unmapped page: a word read that
+// crossed into it would fault
+static int check_strings(void) {
+    static const size_t limits[] = { 0, 1, 3, 4, 5, 8, 17, 100 };
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    char *area = mmap(NULL, 4 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED) {
+        perror("membench: mmap");
+        return 0;
+    }
+    mprotect(area + page, page, PROT_NONE);
+    mprotect(area + 3 * page, page, PROT_NONE);
+    char *end1 = area + page;
+    char *end2 = area + 3 * page;
+
+    for (size_t len1 = 0; len1 <= 40; len1++) {
+        char *s1 = string_before(end1, len1, SIZE_MAX);
+        if (strlen(s1) != len1) {
+            printf("strlen: got %zu for a %zu-character string\n", strlen(s1), len1);
+            return 0;
+        }
+
+        for (size_t len2 = 0; len2 <= 40; len2++) {
+            for (int differ = 0; differ < 2; differ++) {
+                size_t at = differ ? (len1 < len2 ? len1 : len2) / 2 : SIZE_MAX;
+                char *s2 = string_before(end2, len2, at);
+
+                if (sign(strcmp(s1, s2)) != sign(ref_strcmp(s1, s2)) ||
+                    sign(strcmp(s2, s1)) != sign(ref_strcmp(s2, s1))) {
+                    printf("strcmp mismatch: lengths %zu/%zu, difference at %zu\n", len1, len2, at);
+                    return 0;
+                }
+                for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+                    size_t n = limits[i];
+                    if (sign(strncmp(s1, s2, n)) != sign(ref_strncmp(s1, s2, n)) ||
+                        sign(strncmp(s2, s1, n)) != sign(ref_strncmp(s2, s1, n))) {
+                        printf("strncmp mismatch: lengths %zu/%zu, n=%zu, difference at %zu\n", len1, len2, n, at);
+                        return 0;
+                    }
+                }
+            }
+        }
+    }
+    munmap(area, 4 * page);
+    return 1;
+}
+
+// Every size up to 300 bytes and a few around the larger thresholds, at
+// all alignments, before timing anything
+static int self_check(void) {
+    static const size_t large[] = {
+        511, 512, 513, 1000, 2047, 2048, 2049, 4096, 5001, 65535, 65536, 70001
+    };
+    unsigned char *ref = malloc(CHECK_MAX);
+    unsigned char *out = malloc(CHECK_MAX);
+    int ok = ref != NULL && out != NULL;
+
+    for (size_t i = 0; ok && i < CHECK_MAX; i++) {
+        ref[i] = (unsigned char)(i * 7 + 3);
+    }
+    for (size_t off_d = 0; ok && off_d < 4; off_d++) {
+        for (size_t off_s = 0; ok && off_s < 4; off_s++) {
+            for (size_t n = 0; ok && n <= 300; n++) {
+                ok = check_size(ref, out, n, off_d, off_s);
+            }
+            for (size_t i = 0; ok && i < sizeof(large) / sizeof(large[0]); i++) {
+                ok = check_size(ref, out, large[i], off_d, off_s);
+            }
+        }
+    }
+    free(ref);
+    free(out);
+    return ok && check_strings();
+}
+
+int main(int argc, char **argv) {
+    unsigned long scale = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && argv[i][1] == 'i' && i + 1 < argc) {
+            scale = strtoul(argv[++i], NULL, 0);
+        } else if (argv[i][0] == '-' && argv[i][1] == 's') {
+            mem_set_accel(&host_sse2);
+        } else {
+            fprintf(stderr, "usage: %s [-s] [-i iterations-scale]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    buf_a = aligned_alloc(64, MAX_SIZE + 64);
+    buf_b = aligned_alloc(64, MAX_SIZE + 64);
+    if (buf_a == NULL || buf_b == NULL) {
+        fprintf(stderr, "membench: out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < MAX_SIZE + 64; i++) {
+        buf_a[i] = buf_b[i] = (unsigned char)(i % 251);   // Never 0xFF
+    }
+
+    if (!self_check()) {
+        return 1;
+    }
+
+    printf("%8s", "bytes");
+    for (size_t b = 0; b < BENCH_COUNT; b++) {
+        printf(" %9s", benches[b].name);
+    }
+    printf("   (bytes/cycle)\n");
+
+    for (size_t size = 1; size <= MAX_SIZE; size *= 2) {
+        // Roughly 4 MiB of traffic per measurement, and never too few calls
+        unsigned long iters = (4ul << 20) / size;
+        if (iters < 64) {
+            iters = 64;
+        }
+        iters *= scale;
+
+        printf("%8zu", size);
+        for (size_t b = 0; b < BENCH_COUNT; b++) {
+            // memcmp must see equal buffers, and the others scribble on buf_a
+            byte_copy(buf_a, buf_b, size + 8);
+            printf(" %9.2f", measure(benches[b].fn, size, iters));
+        }
+        printf("\n");
+    }
+
+    str_a = aligned_alloc(64, MAX_STRING + 64);
+    str_b = aligned_alloc(64, MAX_STRING + 64);
+    str_c = (char *)aligned_alloc(64, MAX_STRING + 64) + 1;
+
+    printf("\n%8s", "chars");
+    for (size_t b = 0; b < STR_BENCH_COUNT; b++) {
+        printf(" %11s", str_benches[b].name);
+    }
+    printf("   (bytes/cycle)\n");
+
+    for (size_t size = 1; size <= MAX_STRING; size *= 2) {
+        unsigned long iters = (1ul << 20) / size * scale;
+
+        set_strings(size);
+        printf("%8zu", size);
+        for (size_t b = 0; b < STR_BENCH_COUNT; b++) {
+            printf(" %11.2f", measure(str_benches[b].fn, size, iters));
+        }
+        printf("\n");
+    }
+    return 0;
+}
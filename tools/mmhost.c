@@ -0,0 +1,172 @@
+#include "mmhost.h"
+#include "../include/kernel/mm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Stand-ins for the frame allocator, the page tables and the console, so
+// that kernel/mm.c links into an ordinary Linux process. The heap window
+// is reserved at its real address (KERNEL_HEAP_START) with no access, and
+// "mapping" a page just makes it readable and writable.
+
+#define HOST_HEAP_PAGES (KERNEL_HEAP_MAX / PAGE_SIZE)
+
+// Fake frame number behind every page of the heap window (0 = unmapped)
+static uintptr_t page_frame[HOST_HEAP_PAGES];
+static uintptr_t next_frame;
+static size_t pages_mapped;
+static size_t pages_peak;
+static size_t map_calls;
+static size_t unmap_calls;
+static bool interrupt_context;
+
+static inline size_t page_index(void* virt) {
+    return ((uintptr_t)virt - KERNEL_HEAP_START) / PAGE_SIZE;
+}
+
+static inline bool in_window(void* virt) {
+    return (uintptr_t)virt >= KERNEL_HEAP_START &&
+           (uintptr_t)virt < (uintptr_t)KERNEL_HEAP_START + KERNEL_HEAP_MAX;
+}
+
+// Reserve the heap window; must run before the first mm_init()
+void mmhost_init(void) {
+    void *p = mmap((void*)(uintptr_t)KERNEL_HEAP_START, KERNEL_HEAP_MAX, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+    if (p != (void*)(uintptr_t)KERNEL_HEAP_START) {
+        perror("mmhost: cannot reserve the heap window");
+        exit(1);
+    }
+}
+
+// Drop every mapping and counter so mm_init() starts from a clean window
+void mmhost_reset(void) {
+    madvise((void*)(uintptr_t)KERNEL_HEAP_START, KERNEL_HEAP_MAX, MADV_DONTNEED);
+    mprotect((void*)(uintptr_t)KERNEL_HEAP_START, KERNEL_HEAP_MAX, PROT_NONE);
+    memset(page_frame, 0, sizeof(page_frame));
+    next_frame = 0x100000;
+    pages_mapped = 0;
+    pages_peak = 0;
+    map_calls = 0;
+    unmap_calls = 0;
+}
+
+void mmhost_get_stats(mmhost_stats_t* stats) {
+    stats->pages_mapped = pages_mapped;
+    stats->pages_peak = pages_peak;
+    stats->map_calls = map_calls;
+    stats->unmap_calls = unmap_calls;
+}
+
+// Frame allocator: hand out distinct fake addresses, never backed
+void pfa_init(void) {
+}
+
+void* pfa_alloc(void) {
+    next_frame += PAGE_SIZE;
+    return (void*)next_frame;
+}
+
+// Pages of the heap window read as zero whenever they get mapped
+// (mmhost_reset() and vmm_unmap_page() discard their contents)
+void* pfa_alloc_zeroed(void) {
+    return pfa_alloc();
+}
+
+void pfa_zero_stats(size_t* pooled, size_t* hits, size_t* misses) {
+    *pooled = 0;
+    *hits = 0;
+    *misses = 0;
+}
+
+void* pfa_alloc_order(unsigned order) {
+    void *frame = (void*)(next_frame + PAGE_SIZE);
+    next_frame += (uintptr_t)PAGE_SIZE << order;
+    return frame;
+}
+
+void pfa_free(void* page) {
+    (void)page;
+}
+
+size_t pfa_total_frames(void) {
+    return HOST_HEAP_PAGES;
+}
+
+size_t pfa_free_frames(void) {
+    return HOST_HEAP_PAGES - pages_mapped;
+}
+
+uintptr_t pfa_max_address(void) {
+    return MM_PHYS_LIMIT;
+}
+
+void mm_add_region(uintptr_t base, size_t size, uint32_t type) {
+    (void)base;
+    (void)size;
+    (void)type;
+}
+
+bool mm_have_memory_map(void) {
+    return true;
+}
+
+// Page tables: only the heap window can be mapped
+void vmm_init(void) {
+}
+
+void* vmm_map_page(void* phys, void* virt) {
+    return vmm_map_page_flags(phys, virt, VMM_WRITE);
+}
+
+void* vmm_map_page_flags(void* phys, void* virt, uint32_t flags) {
+    (void)flags;
+    if (!in_window(virt) || mprotect(virt, PAGE_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        return NULL;
+    }
+
+    size_t idx = page_index(virt);
+    if (page_frame[idx] == 0) {
+        pages_mapped++;
+        if (pages_mapped > pages_peak) {
+            pages_peak = pages_mapped;
+        }
+    }
+    page_frame[idx] = (uintptr_t)phys;
+    map_calls++;
+    return virt;
+}
+
+void vmm_unmap_page(void* virt) {
+    if (!in_window(virt)) {
+        return;
+    }
+
+    size_t idx = page_index(virt);
+    if (page_frame[idx] != 0) {
+        pages_mapped--;
+        page_frame[idx] = 0;
+    }
+    madvise(virt, PAGE_SIZE, MADV_DONTNEED);
+    mprotect(virt, PAGE_SIZE, PROT_NONE);
+    unmap_calls++;
+}
+
+uintptr_t vmm_get_physical(void* virt) {
+    return in_window(virt) ? page_frame[page_index(virt)] : 0;
+}
+
+// Pretend to be inside an IRQ handler (for exercising the interrupt path)
+void mmhost_set_interrupt(bool on) {
+    interrupt_context = on;
+}
+
+bool in_interrupt(void) {
+    return interrupt_context;
+}
+
+// Console output is discarded
+void vga_puts(const char* str) {
+    (void)str;
+}
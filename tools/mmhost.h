@@ -0,0 +1,28 @@
+#ifndef TOOLS_MMHOST_H
+#define TOOLS_MMHOST_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Host environment for running kernel/mm.c as a Linux userspace library
+
+// Page mapping counters kept by the stand-in VMM
+typedef struct {
+    size_t pages_mapped;    // Heap pages mapped right now
+    size_t pages_peak;      // Most heap pages mapped at once
+    size_t map_calls;
+    size_t unmap_calls;
+} mmhost_stats_t;
+
+// Reserve the kernel heap window (once per process)
+void mmhost_init(void);
+
+// Unmap everything and clear the counters before re-running mm_init()
+void mmhost_reset(void);
+
+void mmhost_get_stats(mmhost_stats_t* stats);
+
+// Make in_interrupt() report IRQ context to the memory manager
+void mmhost_set_interrupt(bool on);
+
+#endif // TOOLS_MMHOST_H
@@ -0,0 +1,835 @@
+#include "mmhost.h"
+#include "../include/kernel/mm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// Replay alloc/free traces through kernel/mm.c on the host.
+//
+// A trace is a text file with one operation per line; ids name live
+// allocations and may be reused once freed:
+//
+//     a <id> <size>    kmalloc
+//     c <id> <size>    kcalloc(1, size)
+//     r <id> <size>    krealloc (an id that isn't live acts as kmalloc)
+//     f <id>           kfree
+//
+// Lines starting with '#' are ignored. Instead of a file, one of the
+// built-in synthetic workloads can be named with -s, -F times kfree
+// against the number of blocks in the heap, -G compares growing a buffer
+// with krealloc against kmalloc, copy and kfree, and -I runs kmalloc and
+// kfree from simulated interrupt handlers and checks the results.
+//
+// Every trace is replayed twice: once straight through for the overall ns/op,
+// then with a clock around each operation and periodic heap walks for the
+// per-kind latencies, peak use and fragmentation.
+
+#define MAX_IDS         (1u << 20)
+#define SAMPLE_EVERY    1024
+
+enum op_kind { OP_ALLOC, OP_CALLOC, OP_REALLOC, OP_FREE, OP_KINDS };
+
+static const char *kind_names[OP_KINDS] = { "kmalloc", "kcalloc", "krealloc", "kfree" };
+
+struct op {
+    uint8_t kind;
+    uint32_t id;
+    uint32_t size;
+};
+
+struct trace {
+    struct op *ops;
+    size_t count;
+    size_t cap;
+};
+
+struct result {
+    double ns_per_op;
+    uint64_t kind_ns[OP_KINDS];
+    uint64_t kind_max_ns[OP_KINDS];
+    size_t kind_ops[OP_KINDS];
+    size_t failed;
+    size_t live_bytes;
+    size_t live_peak;
+    double frag_max;
+    double frag_end;
+};
+
+static void* live[MAX_IDS];
+static uint32_t live_size[MAX_IDS];
+
+static void trace_push(struct trace *t, enum op_kind kind, uint32_t id, uint32_t size) {
+    if (t->count == t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 4096;
+        t->ops = realloc(t->ops, t->cap * sizeof(struct op));
+        if (t->ops == NULL) {
+            fprintf(stderr, "mmreplay: out of memory\n");
+            exit(1);
+        }
+    }
+    t->ops[t->count].kind = (uint8_t)kind;
+    t->ops[t->count].id = id % MAX_IDS;
+    t->ops[t->count].size = size;
+    t->count++;
+}
+
+static int trace_load(struct trace *t, const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[128];
+    size_t lineno = 0;
+
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char kind;
+        unsigned long id, size = 0;
+
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        int n = sscanf(line, " %c %lu %lu", &kind, &id, &size);
+        if (n >= 2 && kind == 'f') {
+            trace_push(t, OP_FREE, (uint32_t)id, 0);
+        } else if (n == 3 && kind == 'a') {
+            trace_push(t, OP_ALLOC, (uint32_t)id, (uint32_t)size);
+        } else if (n == 3 && kind == 'c') {
+            trace_push(t, OP_CALLOC, (uint32_t)id, (uint32_t)size);
+        } else if (n == 3 && kind == 'r') {
+            trace_push(t, OP_REALLOC, (uint32_t)id, (uint32_t)size);
+        } else {
+            fprintf(stderr, "%s:%zu: bad trace line\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// xorshift32, so synthetic traces are identical on every run
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi) {
+    return lo + rng() % (hi - lo + 1);
+}
+
+// Mostly small objects with a tail of page-sized and larger buffers
+static uint32_t mixed_size(void) {
+    uint32_t r = rng() % 100;
+    if (r < 75) {
+        return rng_range(8, MM_SMALL_MAX);
+    }
+    if (r < 95) {
+        return rng_range(MM_SMALL_MAX + 1, 4096);
+    }
+    return rng_range(4097, 65536);
+}
+
+// Random alloc/free around a steady live set
+static void gen_random(struct trace *t, size_t n) {
+    uint32_t ids[4096];
+    size_t count = 0;
+    uint32_t next = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (count < 64 || (count < 4096 && rng() % 2 == 0)) {
+            ids[count] = next++;
+            trace_push(t, OP_ALLOC, ids[count++], mixed_size());
+        } else {
+            size_t k = rng() % count;
+            trace_push(t, OP_FREE, ids[k], 0);
+            ids[k] = ids[--count];
+        }
+    }
+}
+
+// Thousands of live large blocks with holes between them, then churn: every
+// allocation has to search a long block list and every free has to merge
+static void gen_churn(struct trace *t, size_t n) {
+    const uint32_t blocks = 6000;
+
+    for (uint32_t i = 0; i < blocks; i++) {
+        trace_push(t, OP_ALLOC, i, rng_range(600, 2000));
+    }
+    for (uint32_t i = 0; i < blocks; i += 2) {
+        trace_push(t, OP_FREE, i, 0);
+    }
+    while (t->count < n) {
+        uint32_t id = (rng_range(0, blocks / 2 - 1) * 2) + 1;
+        trace_push(t, OP_FREE, id, 0);
+        trace_push(t, OP_ALLOC, id, rng_range(600, 2400));
+    }
+}
+
+// Buffers that grow by small appends, with short-lived small objects
+// allocated in between so the buffers have neighbours
+static void gen_append(struct trace *t, size_t n) {
+    const uint32_t buffers = 64;
+    uint32_t size[64] = { 0 };
+    uint32_t tmp = buffers;
+
+    while (t->count < n) {
+        uint32_t b = rng() % buffers;
+        size[b] += rng_range(16, 256);
+        if (size[b] > 65536) {
+            trace_push(t, OP_FREE, b, 0);
+            size[b] = rng_range(16, 256);
+        }
+        trace_push(t, OP_REALLOC, b, size[b]);
+
+        if (rng() % 4 == 0) {
+            trace_push(t, OP_ALLOC, tmp, rng_range(16, 1024));
+            trace_push(t, OP_FREE, tmp, 0);
+            tmp = tmp + 1 < MAX_IDS ? tmp + 1 : buffers;
+        }
+    }
+}
+
+// Allocate a batch, then free it oldest first
+static void gen_fifo(struct trace *t, size_t n) {
+    const uint32_t batch = 2048;
+
+    while (t->count < n) {
+        for (uint32_t i = 0; i < batch; i++) {
+            trace_push(t, OP_ALLOC, i, mixed_size());
+        }
+        for (uint32_t i = 0; i < batch; i++) {
+            trace_push(t, OP_FREE, i, 0);
+        }
+    }
+}
+
+static const struct {
+    const char *name;
+    void (*gen)(struct trace *t, size_t n);
+    const char *desc;
+} workloads[] = {
+    { "random", gen_random, "random alloc/free of mixed sizes" },
+    { "churn",  gen_churn,  "long block list, large alloc/free (free latency)" },
+    { "append", gen_append, "append-heavy krealloc growth" },
+    { "fifo",   gen_fifo,   "batch allocate, free oldest first" },
+};
+
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// External fragmentation: share of free heap memory outside the largest
+// free block (0 when all free space is one block)
+static double fragmentation(void) {
+    memory_stats_t stats;
+    mm_get_stats(&stats);
+    if (stats.free_memory == 0) {
+        return 0.0;
+    }
+    return 1.0 - (double)stats.largest_free / (double)stats.free_memory;
+}
+
+static void heap_reset(void) {
+    mmhost_reset();
+    memset(live, 0, sizeof(live));
+    memset(live_size, 0, sizeof(live_size));
+    mm_init(0);
+}
+
+static void* run_op(const struct op *op, struct result *res) {
+    void *p = NULL;
+
+    switch (op->kind) {
+    case OP_ALLOC:
+        if (live[op->id] != NULL) {
+            return NULL;
+        }
+        p = kmalloc(op->size);
+        break;
+    case OP_CALLOC:
+        if (live[op->id] != NULL) {
+            return NULL;
+        }
+        p = kcalloc(1, op->size);
+        break;
+    case OP_REALLOC:
+        p = krealloc(live[op->id], op->size);
+        if (op->size == 0) {
+            // krealloc(p, 0) frees the block and returns NULL
+            res->live_bytes -= live_size[op->id];
+            live[op->id] = NULL;
+            live_size[op->id] = 0;
+            return NULL;
+        }
+        if (p == NULL) {
+            // The old block is still valid when krealloc fails
+            res->failed++;
+            return NULL;
+        }
+        res->live_bytes -= live_size[op->id];
+        break;
+    case OP_FREE:
+        kfree(live[op->id]);
+        res->live_bytes -= live_size[op->id];
+        live[op->id] = NULL;
+        live_size[op->id] = 0;
+        return NULL;
+    }
+
+    if (p == NULL) {
+        res->failed++;
+        return NULL;
+    }
+    live[op->id] = p;
+    live_size[op->id] = op->size;
+    res->live_bytes += op->size;
+    if (res->live_bytes > res->live_peak) {
+        res->live_peak = res->live_bytes;
+    }
+    return p;
+}
+
+static void replay(const struct trace *t, struct result *res) {
+    memset(res, 0, sizeof(*res));
+
+    // Pass 1: wall time for the whole trace
+    heap_reset();
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < t->count; i++) {
+        run_op(&t->ops[i], res);
+    }
+    res->ns_per_op = t->count ? (double)(now_ns() - start) / (double)t->count : 0.0;
+
+    // Pass 2: per-operation latency and heap shape
+    size_t failed = res->failed;
+    double ns_per_op = res->ns_per_op;
+    memset(res, 0, sizeof(*res));
+    res->ns_per_op = ns_per_op;
+    heap_reset();
+    for (size_t i = 0; i < t->count; i++) {
+        const struct op *op = &t->ops[i];
+        uint64_t t0 = now_ns();
+        run_op(op, res);
+        uint64_t dt = now_ns() - t0;
+
+        res->kind_ns[op->kind] += dt;
+        res->kind_ops[op->kind]++;
+        if (dt > res->kind_max_ns[op->kind]) {
+            res->kind_max_ns[op->kind] = dt;
+        }
+        if (i % SAMPLE_EVERY == 0) {
+            double frag = fragmentation();
+            if (frag > res->frag_max) {
+                res->frag_max = frag;
+            }
+        }
+    }
+    res->frag_end = fragmentation();
+    if (res->frag_end > res->frag_max) {
+        res->frag_max = res->frag_end;
+    }
+    res->failed = failed;
+}
+
+static void report(const char *name, const struct trace *t, const struct result *res) {
+    memory_stats_t stats;
+    mmhost_stats_t host;
+
+    mm_get_stats(&stats);
+    mmhost_get_stats(&host);
+
+    printf("%s: %zu ops\n", name, t->count);
+    printf("  ns/op          %10.1f\n", res->ns_per_op);
+    for (int k = 0; k < OP_KINDS; k++) {
+        if (res->kind_ops[k] == 0) {
+            continue;
+        }
+        printf("  %-14s %10.1f ns avg %8llu ns max (%zu ops)\n", kind_names[k],
+               (double)res->kind_ns[k] / (double)res->kind_ops[k],
+               (unsigned long long)res->kind_max_ns[k], res->kind_ops[k]);
+    }
+    printf("  peak heap      %10zu KB (%zu pages)\n", host.pages_peak * PAGE_SIZE / 1024, host.pages_peak);
+    printf("  peak live      %10zu KB requested\n", res->live_peak / 1024);
+    printf("  fragmentation  %9.1f%% max %.1f%% at end\n", res->frag_max * 100.0, res->frag_end * 100.0);
+    printf("  longest walk   %10zu blocks\n", stats.max_walk);
+    printf("  blocks at end  %10zu\n", stats.block_count);
+    printf("  krealloc       %10zu in place %zu moved\n", stats.realloc_inplace, stats.realloc_moved);
+    printf("  map/unmap      %10zu / %zu pages\n", host.map_calls, host.unmap_calls);
+    if (res->failed) {
+        printf("  failed         %10zu ops\n", res->failed);
+    }
+}
+
+// Free latency against heap size: fill the block list with n small blocks,
+// then free a random sample of them. The blocks come straight from
+// heap_alloc so that tens of thousands of them fit in the heap window; a
+// large kfree takes the same path.
+//
+// With boundary tags a free touches only the block and its two neighbours,
+// so the work per free does not depend on n. What does grow is the chance
+// that those headers are out of the cache and TLB, since random frees are
+// spread over the whole list (2.4MB of headers and payload at 50K blocks).
+// A second sample of the same size is freed in address order, which keeps
+// the same work per free but walks memory sequentially; it stays flat.
+//
+// For scale, "walk" is the time the last allocations of the fill took:
+// first fit walks the whole list to reach the free space at the top, as
+// kfree did to find a block's predecessor before the boundary tags (on
+// average half the list). Filling is quadratic for the same reason, hence
+// the cap on n.
+static const uint32_t sweep_blocks[] = { 1000, 2000, 5000, 10000, 20000, 35000, 50000 };
+
+#define SWEEP_MAX        50000
+#define SWEEP_FREES      4096   // Per order, at most a quarter of the blocks
+#define SWEEP_WALKS      64     // Fill allocations timed for the walk column
+#define SWEEP_BLOCK_SIZE 32
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Free blocks[order[0..count)] one by one; returns the average ns and
+// stores the median and 99th percentile
+static double sweep_free(void **blocks, const uint32_t *order, uint32_t count,
+                         uint32_t *p50, uint32_t *p99) {
+    static uint32_t lat[SWEEP_FREES];
+    uint64_t total = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t t0 = now_ns();
+        heap_free(blocks[order[i]]);
+        uint64_t dt = now_ns() - t0;
+        total += dt;
+        lat[i] = dt > UINT32_MAX ? UINT32_MAX : (uint32_t)dt;
+    }
+    qsort(lat, count, sizeof(lat[0]), cmp_u32);
+    *p50 = lat[count / 2];
+    *p99 = lat[count - 1 - count / 100];
+    return (double)total / (double)count;
+}
+
+static void free_sweep(void) {
+    static void *blocks[SWEEP_MAX];
+    static uint32_t order[SWEEP_MAX];
+
+    printf("free latency against heap size (%u-byte blocks, ns)\n", SWEEP_BLOCK_SIZE);
+    printf("  %8s %6s %8s %6s %6s %10s %8s\n",
+           "blocks", "frees", "random", "p50", "p99", "in order", "walk");
+    for (size_t s = 0; s < sizeof(sweep_blocks) / sizeof(sweep_blocks[0]); s++) {
+        uint32_t n = sweep_blocks[s];
+        uint32_t frees = n / 4 < SWEEP_FREES ? n / 4 : SWEEP_FREES;
+        uint64_t walk = 0;
+        uint32_t p50, p99, seq50, seq99;
+        memory_stats_t stats;
+
+        heap_reset();
+        rng_state = 0x2545F491;
+        for (uint32_t i = 0; i < n; i++) {
+            uint64_t t0 = now_ns();
+            blocks[i] = heap_alloc(SWEEP_BLOCK_SIZE);
+            if (i >= n - SWEEP_WALKS) {
+                walk += now_ns() - t0;
+            }
+            if (blocks[i] == NULL) {
+                printf("  %8u heap full after %u blocks\n", n, i);
+                return;
+            }
+            order[i] = i;
+        }
+
+        // Partial Fisher-Yates: the first 2 * frees entries are a random
+        // sample; the second half is then sorted into address order
+        for (uint32_t i = 0; i < 2 * frees; i++) {
+            uint32_t j = rng_range(i, n - 1);
+            uint32_t tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+        qsort(order + frees, frees, sizeof(order[0]), cmp_u32);
+
+        mm_get_stats(&stats);
+        size_t before = stats.block_count;
+        double random = sweep_free(blocks, order, frees, &p50, &p99);
+        double in_order = sweep_free(blocks, order + frees, frees, &seq50, &seq99);
+        printf("  %8zu %6u %8.1f %6u %6u %10.1f %8.1f\n", before, frees, random, p50, p99,
+               in_order, (double)walk / SWEEP_WALKS);
+    }
+}
+
+// Append growth: a buffer grows 64 bytes at a time up to each final size,
+// either through krealloc or by allocating the new size, copying and
+// freeing the old buffer. In the "pinned" runs a 1KB block is allocated
+// after every 16th append and kept, so the buffer keeps getting a live
+// neighbour and can't always grow in place.
+static const uint32_t grow_sizes[] = { 1024, 4096, 16384, 65536, 262144 };
+
+#define GROW_STEP       64
+#define GROW_PIN_EVERY  16
+
+static uint64_t grow_run(uint32_t final, bool use_realloc, bool pinned, size_t *moved) {
+    uint64_t start = now_ns();
+    uint8_t *buf = NULL;
+    memory_stats_t stats;
+
+    for (uint32_t size = GROW_STEP; size <= final; size += GROW_STEP) {
+        uint8_t *p;
+        if (use_realloc) {
+            p = krealloc(buf, size);
+        } else {
+            p = kmalloc(size);
+            if (p != NULL && buf != NULL) {
+                memcpy(p, buf, size - GROW_STEP);
+                kfree(buf);
+            }
+        }
+        if (p == NULL) {
+            fprintf(stderr, "mmreplay: heap full growing to %u bytes\n", size);
+            exit(1);
+        }
+        buf = p;
+        memset(buf + size - GROW_STEP, 0xA5, GROW_STEP);
+        if (pinned && (size / GROW_STEP) % GROW_PIN_EVERY == 0) {
+            kmalloc(1024);
+        }
+    }
+    uint64_t dt = now_ns() - start;
+
+    mm_get_stats(&stats);
+    *moved = stats.realloc_moved;
+    return dt;
+}
+
+static void grow_bench(void) {
+    printf("append growth, %u bytes per append (ns per append)\n", GROW_STEP);
+    printf("  %8s %-7s %10s %10s %8s\n", "size", "", "krealloc", "copy", "moved");
+    for (size_t s = 0; s < sizeof(grow_sizes) / sizeof(grow_sizes[0]); s++) {
+        uint32_t final = grow_sizes[s];
+        uint32_t appends = final / GROW_STEP;
+        uint32_t reps = 1048576 / final;
+
+        for (int pinned = 0; pinned < 2; pinned++) {
+            uint64_t t_realloc = 0, t_copy = 0;
+            size_t moved = 0;
+
+            for (uint32_t i = 0; i < reps; i++) {
+                heap_reset();
+                t_realloc += grow_run(final, true, pinned, &moved);
+                heap_reset();
+                t_copy += grow_run(final, false, pinned, &(size_t){ 0 });
+            }
+            printf("  %8u %-7s %10.1f %10.1f %4zu/%u\n", final, pinned ? "pinned" : "alone",
+                   (double)t_realloc / ((double)reps * appends),
+                   (double)t_copy / ((double)reps * appends), moved, appends);
+        }
+    }
+}
+
+// Interrupt-context check (-I): a mainline kmalloc/kfree mix with simulated
+// handlers in between. Handlers allocate small objects from the reserves,
+// kfree objects kept by earlier handlers (deferred) and try krealloc, which
+// must refuse to move anything. Every object carries a tag byte that is
+// checked before it's freed, so a reserve object handed out twice or one
+// overlapping a mainline block shows up as a corrupted tag.
+#define IRQ_ROUNDS      20000
+#define IRQ_MAIN_IDS    256
+#define IRQ_HELD        64
+#define IRQ_BURST       12      // More than the reserve holds per class
+#define IRQ_BURST_EVERY 64
+
+struct tagged {
+    uint8_t *p;
+    uint32_t size;
+    uint8_t tag;
+};
+
+static size_t irq_errors;
+
+static void irq_error(const char *what, const void *p) {
+    if (irq_errors++ < 10) {
+        fprintf(stderr, "irq: %s (%p)\n", what, p);
+    }
+}
+
+// A fresh object must lie inside the mapped heap and be 8-byte aligned
+static bool irq_valid(const void *p, size_t heap_size) {
+    uintptr_t a = (uintptr_t)p;
+    return a >= KERNEL_HEAP_START && a < KERNEL_HEAP_START + heap_size && (a & 7) == 0;
+}
+
+static void tag_set(struct tagged *t, void *p, uint32_t size, uint8_t tag) {
+    t->p = p;
+    t->size = size;
+    t->tag = tag;
+    memset(p, tag, size);
+}
+
+static void tag_check(const struct tagged *t) {
+    for (uint32_t i = 0; i < t->size; i++) {
+        if (t->p[i] != t->tag) {
+            irq_error("object overwritten", t->p);
+            return;
+        }
+    }
+}
+
+static void irq_check(void) {
+    static struct tagged main_obj[IRQ_MAIN_IDS], held[IRQ_HELD];
+    size_t handlers = 0, reserve_ok = 0, reserve_empty = 0, oversized = 0;
+    size_t realloc_refused = 0, deferred = 0, refilled = 0, expect_failed = 0;
+    memory_stats_t stats;
+
+    heap_reset();
+    memset(main_obj, 0, sizeof(main_obj));
+    memset(held, 0, sizeof(held));
+    rng_state = 0x2545F491;
+    irq_errors = 0;
+
+    // mm_init leaves the reserves empty until the first mainline call
+    kfree(kmalloc(16));
+    unsigned empty_classes = 0;
+
+    for (uint32_t round = 0; round < IRQ_ROUNDS; round++) {
+        for (int k = 0; k < 4; k++) {
+            struct tagged *t = &main_obj[rng() % IRQ_MAIN_IDS];
+            if (t->p != NULL) {
+                tag_check(t);
+                kfree(t->p);
+                t->p = NULL;
+            } else {
+                uint32_t size = mixed_size();
+                void *p = kmalloc(size);
+                if (p != NULL) {
+                    tag_set(t, p, size, (uint8_t)(0x80 | (t - main_obj)));
+                }
+            }
+        }
+        if (rng() % 4 != 0) {
+            continue;
+        }
+
+        // Everything the last handler freed must be released by the
+        // first mainline heap call after it
+        mm_get_stats(&stats);
+        size_t freed_before = stats.free_count;
+        size_t frees = 0;
+        mm_get_stats(&stats);
+        size_t heap_size = stats.total_memory;
+
+        mmhost_set_interrupt(true);
+        handlers++;
+        bool burst = handlers % IRQ_BURST_EVERY == 0;
+        int cls_burst = (int)(rng() % MM_SIZE_CLASSES);
+        int allocs = burst ? IRQ_BURST : (int)rng_range(1, 4);
+        // Classes a previous handler emptied; mainline has run since
+        unsigned refill_due = empty_classes;
+        empty_classes = 0;
+
+        for (int k = 0; k < allocs; k++) {
+            int cls = burst ? cls_burst : (int)(rng() % MM_SIZE_CLASSES);
+            uint32_t size = rng_range(cls == 0 ? 1 : (16u << (cls - 1)) + 1, 16u << cls);
+            bool zeroed = rng() % 2 == 0;
+            uint8_t *p = zeroed ? kcalloc(1, size) : kmalloc(size);
+            if (p == NULL) {
+                // Right after a refill the class must have something
+                if (refill_due & (1u << cls)) {
+                    irq_error("reserve not refilled", NULL);
+                    refill_due &= ~(1u << cls);
+                }
+                reserve_empty++;
+                expect_failed++;
+                empty_classes |= 1u << cls;
+                continue;
+            }
+            if (refill_due & (1u << cls)) {
+                refilled++;
+                refill_due &= ~(1u << cls);
+            }
+            reserve_ok++;
+            if (!irq_valid(p, heap_size)) {
+                irq_error("reserve object outside the heap", p);
+                continue;
+            }
+            for (uint32_t i = 0; zeroed && i < size; i++) {
+                if (p[i] != 0) {
+                    irq_error("kcalloc object not zeroed", p);
+                    break;
+                }
+            }
+
+            struct tagged *t = &held[rng() % IRQ_HELD];
+            if (t->p != NULL) {
+                tag_check(t);
+                kfree(t->p);
+                frees++;
+            }
+            tag_set(t, p, size, (uint8_t)(0x40 | (t - held)));
+        }
+
+        // Anything above MM_SMALL_MAX is refused outright
+        if (rng() % 8 == 0) {
+            if (kmalloc(MM_SMALL_MAX + 1) != NULL) {
+                irq_error("oversized kmalloc served", NULL);
+            }
+            oversized++;
+            expect_failed++;
+        }
+
+        // krealloc may not move or resize a live object here
+        struct tagged *t = &held[rng() % IRQ_HELD];
+        if (t->p != NULL) {
+            if (krealloc(t->p, t->size * 2) != NULL) {
+                irq_error("krealloc moved an object", t->p);
+            }
+            tag_check(t);
+            realloc_refused++;
+        }
+
+        for (int k = (int)rng_range(0, 3); k > 0; k--) {
+            t = &held[rng() % IRQ_HELD];
+            if (t->p != NULL) {
+                tag_check(t);
+                kfree(t->p);
+                t->p = NULL;
+                frees++;
+            }
+        }
+        mmhost_set_interrupt(false);
+
+        deferred += frees;
+        mm_get_stats(&stats);
+        if (stats.free_count != freed_before) {
+            irq_error("deferred kfree ran in the handler", NULL);
+        }
+        kfree(kmalloc(16));
+        mm_get_stats(&stats);
+        if (stats.free_count != freed_before + frees + 1) {
+            irq_error("deferred kfrees not drained", NULL);
+        }
+    }
+
+    for (size_t i = 0; i < IRQ_MAIN_IDS; i++) {
+        if (main_obj[i].p != NULL) {
+            tag_check(&main_obj[i]);
+            kfree(main_obj[i].p);
+        }
+    }
+    mmhost_set_interrupt(true);
+    for (size_t i = 0; i < IRQ_HELD; i++) {
+        if (held[i].p != NULL) {
+            tag_check(&held[i]);
+            kfree(held[i].p);
+            deferred++;
+        }
+    }
+    mmhost_set_interrupt(false);
+    kfree(kmalloc(16));
+
+    // Every allocation, handlers' included, has been freed exactly once
+    mm_get_stats(&stats);
+    if (stats.alloc_count != stats.free_count) {
+        irq_error("alloc and free counts differ at the end", NULL);
+    }
+    if (stats.irq_alloc_count != reserve_ok || stats.irq_alloc_failed != expect_failed) {
+        irq_error("interrupt counters disagree", NULL);
+    }
+
+    printf("irq: %u rounds, %zu handlers\n", IRQ_ROUNDS, handlers);
+    printf("  reserve allocs  %8zu\n", reserve_ok);
+    printf("  reserve empty   %8zu (%zu classes refilled after)\n", reserve_empty, refilled);
+    printf("  oversized       %8zu refused\n", oversized);
+    printf("  krealloc        %8zu refused\n", realloc_refused);
+    printf("  deferred kfree  %8zu drained\n", deferred);
+    printf("  errors          %8zu\n", irq_errors);
+    if (irq_errors != 0) {
+        exit(1);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: mmreplay [-n ops] [-s workload]... [-F] [-G] [-I] [trace-file]...\n");
+    fprintf(stderr, "workloads (all of them when nothing is given):\n");
+    for (size_t i = 0; i < WORKLOAD_COUNT; i++) {
+        fprintf(stderr, "  %-8s %s\n", workloads[i].name, workloads[i].desc);
+    }
+    fprintf(stderr, "-F times kfree against the number of heap blocks\n");
+    fprintf(stderr, "-G compares krealloc growth with kmalloc+copy\n");
+    fprintf(stderr, "-I checks kmalloc/kfree from simulated interrupt handlers\n");
+    exit(2);
+}
+
+static void run_workload(size_t w, size_t n) {
+    struct trace t = { 0 };
+    struct result res;
+
+    rng_state = 0x2545F491;
+    workloads[w].gen(&t, n);
+    replay(&t, &res);
+    report(workloads[w].name, &t, &res);
+    free(t.ops);
+}
+
+int main(int argc, char **argv) {
+    size_t n = 200000;
+    bool ran = false;
+
+    mmhost_init();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            n = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            size_t w = 0;
+            i++;
+            while (w < WORKLOAD_COUNT && strcmp(workloads[w].name, argv[i]) != 0) {
+                w++;
+            }
+            if (w == WORKLOAD_COUNT) {
+                usage();
+            }
+            run_workload(w, n);
+            ran = true;
+        } else if (strcmp(argv[i], "-F") == 0) {
+            free_sweep();
+            ran = true;
+        } else if (strcmp(argv[i], "-G") == 0) {
+            grow_bench();
+            ran = true;
+        } else if (strcmp(argv[i], "-I") == 0) {
+            irq_check();
+            ran = true;
+        } else if (argv[i][0] == '-') {
+            usage();
+        } else {
+            struct trace t = { 0 };
+            struct result res;
+            if (trace_load(&t, argv[i]) != 0) {
+                return 1;
+            }
+            replay(&t, &res);
+            report(argv[i], &t, &res);
+            free(t.ops);
+            ran = true;
+        }
+    }
+
+    if (!ran) {
+        for (size_t w = 0; w < WORKLOAD_COUNT; w++) {
+            run_workload(w, n);
+        }
+    }
+    return 0;
+}